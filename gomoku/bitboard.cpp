@@ -0,0 +1,64 @@
+#include <algorithm>
+
+#include "bitboard.h"
+#include "util.h"
+
+namespace mcts
+{
+
+template <class Geometry>
+void BasicBitBoard<Geometry>::clear()
+{
+  m_stones[(int)BLACK].reset();
+  m_stones[(int)WHITE].reset();
+  m_hash = 0;
+  m_count[(int)BLACK] = m_count[(int)WHITE] = 0;
+  std::fill(m_row_count, m_row_count + Geometry::size, 0);
+  std::fill(m_col_count, m_col_count + Geometry::size, 0);
+  std::fill(m_cells, m_cells + Geometry::cells, WALL);
+  for (int i = 0; i < m_height; i++) {
+    std::fill(m_cells + index(i, 0), m_cells + index(i, m_width), EMPTY);
+  }
+  std::fill(&m_lines[0][0], &m_lines[0][0] + NUM_DIR * Geometry::lines, ~0ULL);
+  for (int i = 0; i < m_height; i++) {
+    for (int j = 0; j < m_width; j++) {
+      set_lines(i, j, EMPTY);
+    }
+  }
+}
+
+template <class Geometry>
+void BasicBitBoard<Geometry>::load(const Position & position)
+{
+  clear();
+  for (int i = 0; i < m_height; i++) {
+    for (int j = 0; j < m_width; j++) {
+      set(i, j, position[i][j]);
+    }
+  }
+}
+
+template <class Geometry>
+void BasicBitBoard<Geometry>::store(Position & position) const
+{
+  position = Position(m_height, std::vector<char>(m_width, EMPTY));
+  for (int i = 0; i < m_height; i++) {
+    for (int j = 0; j < m_width; j++) {
+      position[i][j] = at(i, j);
+    }
+  }
+}
+
+#ifndef _SPARSE_BOARD
+template class BasicBitBoard<geometry_t>;
+#endif
+
+std::ostream & operator <<(std::ostream & strm, const BitBoard & board)
+{
+  Position position;
+  board.store(position);
+  print_position(strm, position);
+  return strm;
+}
+
+}
@@ -0,0 +1,373 @@
+#ifndef _BITBOARD_H_
+#define _BITBOARD_H_
+
+#include <algorithm>
+#include <bitset>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "constants.h"
+
+namespace mcts
+{
+
+typedef std::vector<std::vector<char> > Position;
+
+/* Walk directions: BOARD_DIRS, then the same lines walked backwards */
+#define NUM_RAYS (2 * NUM_DIR)
+
+/*
+ * Neighbors of a cell along each ray, as flat index steps.
+ * The cell k steps away from index along ray is index + steps[ray][k];
+ * the padding makes these the same for every cell on the board, and its
+ * WALL cells are the sentinel that ends a walk within PAD steps.
+ */
+template <int PAD>
+struct ray_table_t
+{
+  /* BOARD_DIRS index of the line of each ray */
+  int dir[NUM_RAYS];
+  int steps[NUM_RAYS][PAD + 1];
+};
+
+template <int PAD>
+constexpr ray_table_t<PAD> make_ray_table(int stride)
+{
+  ray_table_t<PAD> table {};
+  const int offsets[NUM_DIR] = { stride, 1, stride + 1, 1 - stride };
+  for (int ray = 0; ray < NUM_RAYS; ray++) {
+    const int dir = ray % NUM_DIR;
+    const int offset = (ray < NUM_DIR) ? offsets[dir] : -offsets[dir];
+    table.dir[ray] = dir;
+    for (int k = 0; k <= PAD; k++) {
+      table.steps[ray][k] = k * offset;
+    }
+  }
+  return table;
+}
+
+/*
+ * Compile-time board geometry.
+ * Every board of a build is stored in a SIZE x SIZE frame; a smaller
+ * board (e.g. the 9x9 test positions) occupies its top-left corner.
+ * The frame is surrounded by PAD cells of WALL, so a walk of up to PAD
+ * steps from any cell on the board never leaves the storage and needs
+ * no boundary check.
+ */
+template <int SIZE, int PAD = BOARD_PAD>
+struct board_geometry_t
+{
+  static const int size = SIZE;
+  static const int area = SIZE * SIZE;
+  static const int pad = PAD;
+  static const int stride = SIZE + 2 * PAD;
+  static const int cells = stride * stride;
+  /* Lines per direction (diagonals have 2 * SIZE - 1) */
+  static const int lines = 2 * SIZE - 1;
+
+  static int index(int row, int col)
+  {
+    return (row + PAD) * stride + (col + PAD);
+  }
+
+  static int row(int index)
+  {
+    return index / stride - PAD;
+  }
+
+  static int col(int index)
+  {
+    return index % stride - PAD;
+  }
+
+  static constexpr ray_table_t<PAD> rays = make_ray_table<PAD>(stride);
+
+  /*
+   * @brief flat index step of BOARD_DIRS[dir]
+   * */
+  static int offset(int dir)
+  {
+    return rays.steps[dir][1];
+  }
+
+  /*
+   * @brief line through (row, col) along BOARD_DIRS[dir]
+   * */
+  static int line(int dir, int row, int col)
+  {
+    switch (dir) {
+      case 0: return col;
+      case 1: return row;
+      case 2: return col - row + SIZE - 1;
+      default: return row + col;
+    }
+  }
+
+  /*
+   * @brief position of (row, col) along its line, growing with BOARD_DIRS[dir]
+   * */
+  static int line_pos(int dir, int row, int col)
+  {
+    return (dir == 0) ? row : col;
+  }
+};
+
+template <int SIZE, int PAD>
+constexpr ray_table_t<PAD> board_geometry_t<SIZE, PAD>::rays;
+
+typedef board_geometry_t<BOARD_SIZE> geometry_t;
+
+/*
+ * @brief Zobrist key of a stone of agent_id at cell index
+ *        keys are derived with splitmix64 instead of a random table,
+ *        so they need no initialization and are identical across runs
+ * */
+inline uint64_t zobrist_key(int agent_id, int index)
+{
+  uint64_t z = 0x9e3779b97f4a7c15ULL * (uint64_t)(2 * index + agent_id + 1);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/*
+ * @brief key folded into a state hash when WHITE made the last move
+ * */
+inline uint64_t zobrist_side_key()
+{
+  return 0xd1b54a32d192ed03ULL;
+}
+
+/* Packed line windows: 2 bits per cell, cells -4 .. +4 around the center */
+#define WINDOW_RADIUS 4
+#define WINDOW_CELLS (2 * WINDOW_RADIUS + 1)
+#define WINDOW_BITS (2 * WINDOW_CELLS)
+#define WINDOW_MASK ((1U << WINDOW_BITS) - 1)
+#define window_cell(window, k) (((window) >> (2 * (k))) & 0x3)
+
+/*
+ * Fixed-size board, one bitset per color plus a flat, WALL-padded copy
+ * of the cells for direction walks.
+ * Every row, column and diagonal is also kept as a packed line code
+ * (2 bits per cell, the cell values themselves), so the cells around
+ * any cell in any direction come out of one shift and mask.
+ * The stone counts and the rows and columns in use are tracked on every
+ * set().
+ * Copying a board never touches the heap.
+ */
+template <class Geometry>
+class BasicBitBoard
+{
+public:
+  typedef Geometry geometry;
+
+  BasicBitBoard(int height, int width):
+    m_height(height),
+    m_width(width),
+    m_hash(0)
+  {
+    assert(height <= Geometry::size && width <= Geometry::size);
+    clear();
+  }
+
+  int height() const
+  {
+    return m_height;
+  }
+
+  int width() const
+  {
+    return m_width;
+  }
+
+  static int index(int row, int col)
+  {
+    return Geometry::index(row, col);
+  }
+
+  /*
+   * @return BLACK, WHITE, EMPTY or WALL (outside the board)
+   * */
+  char at(int row, int col) const
+  {
+    return m_cells[Geometry::index(row, col)];
+  }
+
+  char at(int index) const
+  {
+    return m_cells[index];
+  }
+
+  bool is_empty(int row, int col) const
+  {
+    return m_cells[Geometry::index(row, col)] == EMPTY;
+  }
+
+  /*
+   * @brief place a stone of agent_id, or clear the cell with EMPTY
+   * */
+  void set(int row, int col, char agent_id)
+  {
+    set(Geometry::index(row, col), agent_id);
+  }
+
+  void set(int index, char agent_id)
+  {
+    const char old_agent_id = m_cells[index];
+    assert(old_agent_id != WALL);
+    if (old_agent_id != EMPTY) {
+      m_stones[(int)old_agent_id].reset(index);
+      m_hash ^= zobrist_key(old_agent_id, index);
+      m_count[(int)old_agent_id]--;
+    }
+    if (agent_id != EMPTY) {
+      assert(agent_id == BLACK || agent_id == WHITE);
+      m_stones[(int)agent_id].set(index);
+      m_hash ^= zobrist_key(agent_id, index);
+      m_count[(int)agent_id]++;
+    }
+    update_extent(index, old_agent_id, agent_id);
+    m_cells[index] = agent_id;
+    set_lines(Geometry::row(index), Geometry::col(index), agent_id);
+  }
+
+  /*
+   * @brief WINDOW_CELLS cells centered on (row, col) along BOARD_DIRS[dir]
+   *        cell k of the window is window_cell(window, k); cells off the
+   *        board read as WALL
+   * */
+  unsigned window(int row, int col, int dir) const
+  {
+    const uint64_t code = m_lines[dir][Geometry::line(dir, row, col)];
+    return (unsigned)(code >> (2 * Geometry::line_pos(dir, row, col))) & WINDOW_MASK;
+  }
+
+  /*
+   * @brief packed codes of the lines along BOARD_DIRS[dir], indexed by
+   *        Geometry::line(); cell p of a line sits at bit 2 * (p + WINDOW_RADIUS)
+   * */
+  const uint64_t * line_codes(int dir) const
+  {
+    return m_lines[dir];
+  }
+
+  /*
+   * @brief Zobrist key of the stones on the board, updated by set()
+   * */
+  uint64_t hash() const
+  {
+    return m_hash;
+  }
+
+  int count(char agent_id) const
+  {
+    return m_count[(int)agent_id];
+  }
+
+  int stone_count() const
+  {
+    return m_count[(int)BLACK] + m_count[(int)WHITE];
+  }
+
+  bool is_full() const
+  {
+    return stone_count() == m_height * m_width;
+  }
+
+  /*
+   * @brief bounding box of the stones grown by margin cells on each side
+   *        and clipped to the board; top > bottom on an empty board
+   * */
+  void bounding_box(int margin, int & top, int & left, int & bottom, int & right) const
+  {
+    top = 0;
+    bottom = m_height - 1;
+    left = 0;
+    right = m_width - 1;
+    while (top <= bottom && m_row_count[top] == 0) {
+      top++;
+    }
+    if (top > bottom) {
+      return;
+    }
+    while (m_row_count[bottom] == 0) {
+      bottom--;
+    }
+    while (m_col_count[left] == 0) {
+      left++;
+    }
+    while (m_col_count[right] == 0) {
+      right--;
+    }
+    top = std::max(top - margin, 0);
+    left = std::max(left - margin, 0);
+    bottom = std::min(bottom + margin, m_height - 1);
+    right = std::min(right + margin, m_width - 1);
+  }
+
+  void load(const Position & position);
+  void store(Position & position) const;
+
+private:
+  int m_height;
+  int m_width;
+  uint64_t m_hash;
+  int m_count[2];
+  /* Stones on each row and column, for the bounding box */
+  uint8_t m_row_count[Geometry::size];
+  uint8_t m_col_count[Geometry::size];
+  std::bitset<Geometry::cells> m_stones[2];
+  char m_cells[Geometry::cells];
+  uint64_t m_lines[NUM_DIR][Geometry::lines];
+
+  static_assert(2 * (Geometry::size + 2 * WINDOW_RADIUS) <= 64,
+                "line codes must fit in 64 bits");
+
+  void clear();
+
+  static bool is_stone(char value)
+  {
+    return value == BLACK || value == WHITE;
+  }
+
+  void update_extent(int index, char old_value, char value)
+  {
+    const int delta = (int)is_stone(value) - (int)is_stone(old_value);
+    m_row_count[Geometry::row(index)] += delta;
+    m_col_count[Geometry::col(index)] += delta;
+  }
+
+  void set_lines(int row, int col, char value)
+  {
+    for (int dir = 0; dir < NUM_DIR; dir++) {
+      const int shift = 2 * (Geometry::line_pos(dir, row, col) + WINDOW_RADIUS);
+      uint64_t & code = m_lines[dir][Geometry::line(dir, row, col)];
+      code = (code & ~(3ULL << shift)) | ((uint64_t)value << shift);
+    }
+  }
+};
+
+template <class Geometry>
+class BasicSparseBoard;
+
+/*
+ * Board of the build: the dense board by default, the sparse board of
+ * sparse_board.h with _SPARSE_BOARD (large or unbounded boards)
+ */
+#ifdef _SPARSE_BOARD
+typedef BasicSparseBoard<geometry_t> BitBoard;
+#else
+typedef BasicBitBoard<geometry_t> BitBoard;
+#endif
+
+std::ostream & operator <<(std::ostream & strm, const BitBoard & board);
+
+}
+
+#ifdef _SPARSE_BOARD
+#include "sparse_board.h"
+#endif
+
+#endif
@@ -4,27 +4,25 @@
 #include <climits>
 #include <cstdio>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <vector>
 
+#include "bitboard.h"
 #include "debug.h"
 #include "constants.h"
 #include "util.h"
 
-#define NUM_DIR 4
 #define ROW 0
 #define COL 1
 
 namespace mcts
 {
 
-struct board_node_t;
-
 typedef std::vector<char> Row;
 typedef std::vector<Row> Position;
 typedef std::pair<int, int> move_t;
-typedef std::vector<std::vector<board_node_t>> board_t;
-typedef std::vector<std::vector<char>> board_map_t;
+typedef BitBoard board_map_t;
 
 /*
  * Vertical,
@@ -44,7 +42,17 @@ const static int BOARD_DIRS[4][2] = {
  * @field j col
  */
 struct point_t {
-  int i, j;
+  int16_t i, j;
+
+  point_t()
+  {
+  }
+
+  point_t(int _i, int _j):
+    i(_i),
+    j(_j)
+  {
+  }
 
   friend bool operator ==(const point_t & a, const point_t & b)
   {
@@ -52,57 +60,52 @@ struct point_t {
   }
 };
 
+/* threat_t::match_pattern of a threat matching no pattern */
+#define NO_THREAT_PATTERN 0xff
+
+/*
+ * @brief g_threat_types[id], "" for NO_THREAT_PATTERN
+ * */
+const char * threat_pattern_name(int id);
+
 /*
  * @brief define threat struct
+ *        16 bytes and trivially copyable, so lists of threats sort and
+ *        filter without touching the trees below them
  * @field point position in board
- * @field gain number of attack caused by this point
+ * @field first_child, num_children threats this one leads to, a range of
+ *        TssContext::tree() of the context that searched it
+ * @field match_pattern g_threat_types id of the best pattern
  */
 struct threat_t {
   point_t point;
-  std::vector<threat_t> children;
-  bool winning;
-  bool final_winning;
   int min_winning_depth;
-
-  std::string match_pattern;
-  int match_pattern_level;
+  int first_child;
+  uint8_t num_children;
+  uint8_t match_pattern;
+  uint8_t match_pattern_level;
+  bool winning : 1;
+  bool final_winning : 1;
 
   threat_t(point_t _point, bool _winning):
     point(_point),
-    winning(_winning),
-    final_winning(false),
     min_winning_depth(INT_MAX),
-    match_pattern_level(0)
+    first_child(0),
+    num_children(0),
+    match_pattern(NO_THREAT_PATTERN),
+    match_pattern_level(0),
+    winning(_winning),
+    final_winning(false)
   {
 
   }
 
   threat_t():
-    winning(false),
-    final_winning(false),
-    min_winning_depth(INT_MAX),
-    match_pattern_level(0)
+    threat_t(point_t(0, 0), false)
   {
 
   }
 
-  threat_t(const threat_t & copy):
-    point(copy.point),
-    children(copy.children),
-    winning(copy.winning),
-    final_winning(copy.final_winning),
-    min_winning_depth(copy.min_winning_depth),
-    match_pattern(copy.match_pattern),
-    match_pattern_level(copy.match_pattern_level)
-  {
-
-  }
-
-  void print()
-  {
-    print_r(*this, 0);
-  }
-
   friend bool operator > (const threat_t & a, const threat_t & b)
   {
     if (a.final_winning && !b.final_winning) {
@@ -119,48 +122,12 @@ struct threat_t {
   friend std::ostream & operator <<(std::ostream & os, const threat_t & t)
   {
     return os << "(" << (char)(t.point.i + 'A') << ", " << t.point.j << ") = "
-      << "[" << t.winning << ", " << t.final_winning << ", " << t.min_winning_depth  << "] / " << t.match_pattern  << "/" << t.match_pattern_level;
-  }
-
-private:
-  void print_r(threat_t & t, int d)
-  {
-    for (int i = 0; i < d; i++) {
-      putchar('-');
-    }
-    printf("Threat (%c, %d): [%d, %d, %d]\n", t.point.i + 'A', t.point.j, t.winning, t.final_winning, t.min_winning_depth);
-    for (threat_t & child : t.children) {
-      print_r(child, d + 1);
-    }
-  }
-};
-
-struct board_node_t {
-  bool visited[NUM_DIR];
-  int connectivity[NUM_DIR];
-
-  board_node_t():
-    visited { 0 },
-    connectivity { 0 }
-  {
-  }
-
-  ~board_node_t()
-  {
+      << "[" << t.winning << ", " << t.final_winning << ", " << t.min_winning_depth  << "] / "
+      << threat_pattern_name(t.match_pattern) << "/" << (int)t.match_pattern_level;
   }
 };
 
-int update_connectivity_at(board_t & board, const board_map_t & map, int row, int col, int w, int h);
-
-void find_connectivity_at(board_t & board, const board_map_t & map, int agent_id, int row, int col, int dir, int w, int h);
-
-/*
- * @brief fill connectivity in the board
- *        assume board and map has same dimension
- * */
-void find_connectivities(board_t & board, const board_map_t & map, int agent_id);
-
-void show(board_t & board);
+static_assert(sizeof(threat_t) == 16, "threat_t must stay a 16-byte handle");
 
 }
 
@@ -2,12 +2,25 @@
 #define CONSTANTS_H_INCLUDED
 
 #define EXPAND_AROUND_RANGE 2
+#define NUM_DIR 4
+
+/*
+ * Board geometry of this build, e.g. make BOARD_SIZE=19
+ * Boards above 24 need the sparse board: make SPARSE_BOARD=1 BOARD_SIZE=30
+ */
+#ifndef BOARD_SIZE
+#define BOARD_SIZE 15
+#endif
+
+/* WALL cells around the board, enough for the longest threat pattern */
+#define BOARD_PAD 6
 
 namespace mcts
 {
 const char BLACK = 0;
 const char WHITE = 1;
 const char EMPTY = 2;
+const char WALL = 3;
 
 const int NUMTOWIN = 5;
 }
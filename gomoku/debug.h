@@ -23,7 +23,7 @@
 
 #ifdef _DEBUG_FAST_TSS
 #define DEBUG_FAST_TSS(format, args...) printf( "[%s:%d] " format, __FILE__, __LINE__, ##args)
-#define DEBUG_FAST_TSS_POSITION(pos) print_position(std::cout, (pos));
+#define DEBUG_FAST_TSS_POSITION(pos) (std::cout << (pos));
 #else
 #define DEBUG_FAST_TSS(args...)
 #define DEBUG_FAST_TSS_POSITION(pos)
@@ -31,18 +31,12 @@
 
 #ifdef _LOG_FAST_TSS
 #define LOG_FAST_TSS(format, args...) printf( "[%s:%d] " format, __FILE__, __LINE__, ##args)
-#define LOG_FAST_TSS_POSITION(pos) print_position(std::cout, (pos));
+#define LOG_FAST_TSS_POSITION(pos) (std::cout << (pos));
 #else
 #define LOG_FAST_TSS(args...)
 #define LOG_FAST_TSS_POSITION(pos)
 #endif
 
-#ifdef _DEBUG_BOARD
-#define DEBUG_BOARD(format, args...) printf( "[%s:%d] " format, __FILE__, __LINE__, ##args)
-#else
-#define DEBUG_BOARD(args...)
-#endif
-
 #ifdef _DEBUG_PATTERN
 #define DEBUG_PATTERN(format, args...) printf( "[%s:%d] " format, __FILE__, __LINE__, ##args)
 #else
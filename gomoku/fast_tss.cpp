@@ -1,12 +1,145 @@
 #include "fast_tss.h"
 
+#include <limits>
+
 namespace mcts
 {
 
 #define FAST_TSS_MAX_DEPENDENT_RANGE 6
 
+/*
+ * A gain square of level 2 or more lies on a pattern that also holds
+ * another stone of the attacker, at most NUMTOWIN - 1 cells away
+ */
+#define FAST_TSS_SCAN_MARGIN (NUMTOWIN - 1)
+
+static_assert(FAST_TSS_MAX_DEPENDENT_RANGE <= BOARD_PAD + 1,
+              "dependent walks must stay inside the board padding");
+
+/*
+ * A threat gets children from one walk per direction it matches in, and
+ * a walk adds at most one child per cell of each ray
+ */
+static_assert(NUM_DIR * NUM_RAYS * FAST_TSS_MAX_DEPENDENT_RANGE <=
+              std::numeric_limits<decltype(threat_t::num_children)>::max(),
+              "the children of a threat must fit threat_t::num_children");
+
+const char * threat_pattern_name(int id)
+{
+  return (id == NO_THREAT_PATTERN) ? "" : g_threat_types[id];
+}
+
+const PatternTable & threat_pattern_table()
+{
+  static const PatternTable table(g_threat_automaton, PATTERN_TABLE_FILE);
+  return table;
+}
+
+static const PatternTable & g_pattern_table = threat_pattern_table();
+
+/*
+ * @brief PatternTable::scan() mask of the threat patterns from level
+ *        begin to level end
+ * */
+static uint32_t gain_id_mask(int begin, int end)
+{
+  return (2U << g_threat_levels[begin][BEGIN]) - (1U << g_threat_levels[end][END]);
+}
+
+TssTable & tss_table()
+{
+  static TssTable table;
+  return table;
+}
+
+static TssTable & g_tss_table = tss_table();
+
+/* Whether the table can keep every cell of the board */
+static const bool g_tss_table_fits = BitBoard::geometry::cells <= TssTable::MAX_CELLS;
+
+ThreadPool & tss_pool()
+{
+  static ThreadPool pool(TSS_THREADS);
+  return pool;
+}
+
+/*
+ * @brief the child threat from first_child on starting the shortest win,
+ *        -1 for none
+ * */
+static int principal_child(const std::vector<threat_t> & children, int first_child)
+{
+  int best = -1;
+  for (int k = first_child; k < (int)children.size(); k++) {
+    const threat_t & child = children[k];
+    if (child.final_winning && (best < 0 || child.min_winning_depth < children[best].min_winning_depth)) {
+      best = k;
+    }
+  }
+  return best;
+}
+
+TssContext::TssContext():
+  m_board(BitBoard::geometry::size, BitBoard::geometry::size),
+  m_cache_hash(0),
+  m_cache_height(0),
+  m_cache_width(0)
+{
+}
+
+BitBoard & TssContext::load(const BitBoard & board)
+{
+  if (&board != &m_board) {
+    m_board = board;
+  }
+  m_moves.clear();
+  m_tree.clear();
+  m_pending.clear();
+  return m_board;
+}
+
+const ThreatCache & TssContext::threat_cache(const BitBoard & board)
+{
+  if (board.hash() != m_cache_hash || board.height() != m_cache_height || board.width() != m_cache_width) {
+    m_threat_cache.reset(board);
+    m_cache_hash = board.hash();
+    m_cache_height = board.height();
+    m_cache_width = board.width();
+  }
+  return m_threat_cache;
+}
+
+void TssContext::print(const threat_t & threat, int depth) const
+{
+  for (int i = 0; i < depth; i++) {
+    putchar('-');
+  }
+  printf("Threat (%c, %d): [%d, %d, %d]\n", threat.point.i + 'A', threat.point.j,
+         threat.winning, threat.final_winning, threat.min_winning_depth);
+  for (int k = 0; k < threat.num_children; k++) {
+    print(m_tree[threat.first_child + k], depth + 1);
+  }
+}
+
+TssContext & tss_context()
+{
+  static thread_local TssContext context;
+  return context;
+}
+
 mcts::Tss::Tss(const mcts::State & state):
-  m_state(state)
+  m_state(state),
+  m_agent_id(state.agent_id),
+  m_context(tss_context()),
+  m_mode(TSS_FULL_TREE)
+{
+}
+
+mcts::Tss::Tss(const mcts::State & state, int agent_id):
+  m_state(state),
+  m_agent_id(agent_id),
+  m_context(tss_context()),
+  m_mode(TSS_FULL_TREE)
 {
 }
 
@@ -14,54 +147,195 @@ mcts::Tss::~Tss()
 {
 }
 
-int Tss::find_all_threats(std::vector<threat_t> & threats, int begin_level, int end_level, int max_depth)
+int Tss::find_all_threats(std::vector<threat_t> & threats, int begin_level, int end_level, int max_depth, int mode)
 {
-  return find_all_threats(m_state.position, threats, begin_level, end_level, max_depth);
+  return find_all_threats(m_state.board, threats, begin_level, end_level, max_depth, mode);
 }
 
-int Tss::find_all_threats(const Position & position, std::vector<threat_t> & threats, int begin_level, int end_level, int max_depth)
+int Tss::find_all_threats(const BitBoard & board, std::vector<threat_t> & threats, int begin_level, int end_level, int max_depth,
+                          int mode)
 {
-  Position state_position = position;
+  m_mode = mode & ~TSS_PARALLEL;
   threat_t root_threat(point_t{0, 0}, false);
 
-  find_all_threats_r(state_position, threats, begin_level, end_level, 0, max_depth, root_threat);
+  int top, left, bottom, right;
+  board.bounding_box(FAST_TSS_SCAN_MARGIN, top, left, bottom, right);
+
+  /* Gain squares of the whole box in one scan; the rest are skipped */
+  uint8_t * gains = m_context.gains(m_agent_id, (bottom - top + 1) * (right - left + 1) + 1);
+  g_pattern_table.scan(board, m_agent_id, gain_id_mask(begin_level, end_level), top, left, bottom, right, gains);
+  if (mode & TSS_PARALLEL) {
+    find_all_threats_parallel(tss_pool(), m_context.load(board), threats, begin_level, end_level, max_depth,
+                              top, left, bottom, right, gains);
+  } else {
+    find_all_threats_r(m_context.load(board), threats, begin_level, end_level, 0, max_depth, root_threat,
+                       top, left, bottom, right, gains);
+  }
 
   return threats.size();
 }
 
+void Tss::find_all_threats_both(
+  const State & state, std::vector<threat_t> threats[2], int begin_level, int end_level, int max_depth, int mode)
+{
+  find_all_threats_both(state, threats, begin_level, end_level, max_depth, mode, tss_pool());
+}
+
+void Tss::find_all_threats_both(
+  const State & state, std::vector<threat_t> threats[2], int begin_level, int end_level, int max_depth, int mode,
+  ThreadPool & pool)
+{
+  TssContext & context = tss_context();
+  threat_t root_threat(point_t{0, 0}, false);
+
+  int top, left, bottom, right;
+  state.board.bounding_box(FAST_TSS_SCAN_MARGIN, top, left, bottom, right);
+
+  /* One pass classifies every cell for both colors */
+  const int box_area = (bottom - top + 1) * (right - left + 1);
+  uint8_t * gains[2] = { context.gains(BLACK, box_area + 1), context.gains(WHITE, box_area + 1) };
+  g_pattern_table.scan(state.board, gain_id_mask(begin_level, end_level), top, left, bottom, right, gains);
+
+  BitBoard & board = context.load(state.board);
+
+  /* The search restores the board, so both colors share one copy */
+  for (int agent_id = 0; agent_id < 2; agent_id++) {
+    Tss tss(state, agent_id);
+    tss.m_mode = mode & ~TSS_PARALLEL;
+    if (mode & TSS_PARALLEL) {
+      tss.find_all_threats_parallel(pool, board, threats[agent_id], begin_level, end_level, max_depth,
+                                    top, left, bottom, right, gains[agent_id]);
+    } else {
+      tss.find_all_threats_r(board, threats[agent_id], begin_level, end_level, 0, max_depth, root_threat,
+                             top, left, bottom, right, gains[agent_id]);
+    }
+  }
+}
+
+void Tss::find_all_threats_parallel(
+  ThreadPool & pool,
+  BitBoard & board,
+  std::vector<threat_t> & threats,
+  const int begin,
+  const int end,
+  const int max_depth,
+  const int top, const int left, const int bottom, const int right,
+  const uint8_t * gains)
+{
+  const threat_t root_threat(point_t{0, 0}, false);
+  const int box_width = right - left + 1;
+  std::vector<int> cells;
+  for (int k = 0; k < (bottom - top + 1) * box_width; k++) {
+    if (gains[k] != PatternTable::NO_PATTERN) {
+      cells.push_back(k);
+    }
+  }
+
+  if (pool.size() < 2 || cells.size() < 2) {
+    find_all_threats_r(board, threats, begin, end, 0, max_depth, root_threat,
+                       top, left, bottom, right, gains);
+    return;
+  }
+
+  /* Where each cell left its threat and tree in the worker that searched it */
+  struct root_cell_t
+  {
+    int worker;
+    int threat_begin, threat_end;
+    int tree_begin, tree_end;
+  };
+  struct worker_t
+  {
+    TssContext * context;
+    std::vector<threat_t> threats;
+  };
+  std::vector<root_cell_t> results(cells.size());
+  std::vector<worker_t> workers(pool.size(), worker_t{NULL, std::vector<threat_t>()});
+
+  pool.run((int)cells.size(), [&](int task, int worker) {
+    worker_t & self = workers[worker];
+    Tss tss(m_state, m_agent_id);
+    tss.m_mode = m_mode;
+    if (self.context == NULL) {
+      self.context = &tss.m_context;
+      self.context->load(board);
+    }
+
+    /* A box of the one cell, searched as the serial loop would */
+    const int k = cells[task];
+    const int i = top + k / box_width;
+    const int j = left + k % box_width;
+    root_cell_t & cell = results[task];
+    cell.worker = worker;
+    cell.threat_begin = (int)self.threats.size();
+    cell.tree_begin = (int)self.context->m_tree.size();
+    tss.find_all_threats_r(self.context->m_board, self.threats, begin, end, 0, max_depth, root_threat,
+                           i, j, i, j, gains + k);
+    cell.threat_end = (int)self.threats.size();
+    cell.tree_end = (int)self.context->m_tree.size();
+  });
+
+  for (const root_cell_t & cell : results) {
+    const worker_t & worker = workers[cell.worker];
+    const int offset = m_context.append_tree(worker.context->m_tree, cell.tree_begin, cell.tree_end);
+    for (int k = cell.threat_begin; k < cell.threat_end; k++) {
+      threats.push_back(worker.threats[k]);
+      threats.back().first_child += offset;
+    }
+  }
+}
+
 std::pair<bool, int> Tss::find_all_threats_at(
     const threat_t & dependent_threat, std::vector<threat_t> & threats, int begin_level, int end_level, int max_depth)
 {
-  Position position = m_state.position;
-  return find_all_threats_at_gain_square_r(position, threats, begin_level, end_level, 0, max_depth, dependent_threat);
+  return find_all_threats_at(m_context.load(m_state.board), dependent_threat, threats, begin_level, end_level, max_depth);
 }
 
-std::pair<int, int> Tss::is_gain_square(const threat_t & threat, const Position & position, int begin, int end, int dir, int agent_id)
+std::pair<bool, int> Tss::find_all_threats_at(
+    BitBoard & board, const threat_t & dependent_threat, std::vector<threat_t> & threats, int begin_level, int end_level, int max_depth)
+{
+  /* Callers count the winning threats, so none may be cut off */
+  m_mode = TSS_FULL_TREE;
+  return find_all_threats_at_gain_square_r(board, threats, begin_level, end_level, 0, max_depth, dependent_threat);
+}
+
+std::pair<int, int> Tss::is_gain_square(const threat_t & threat, const BitBoard & board, int begin, int end, int dir, int agent_id)
 {
   int begin_pattern_id = g_threat_levels[begin][BEGIN];
   int end_pattern_id = g_threat_levels[end][END];
-  int dr = dirs[dir][DR];
-  int dc = dirs[dir][DC];
-  int match_pos = MISMATCH;
   int row = threat.point.i;
   int col = threat.point.j;
-  int w = m_state.board_height;
-  int h = m_state.board_width;
-  int match_index = 0;
-
-  for (int k = end_pattern_id; k <= begin_pattern_id && match_pos == MISMATCH; k++) {
-    match_pos = match_pattern(position, row, col, w, h, dr, dc,
-                              g_threat_types[k], g_threat_types_len[k], agent_id);
-    if (match_pos != MISMATCH) {
-      match_index = k;
-    }
+  assert(board.at(row, col) == agent_id);
+  PATTERN_STATS_CLOCK(start);
+
+  /* Patterns end_pattern_id .. begin_pattern_id, the lowest one wins */
+  const unsigned window = board.window(row, col, dir);
+  const uint32_t matches = g_pattern_table.matches(window, agent_id);
+  const uint32_t level_mask = (2U << begin_pattern_id) - (1U << end_pattern_id);
+  const uint32_t level_matches = matches & level_mask;
+  PATTERN_STATS_ATTEMPTS(level_mask);
+  if (level_matches == 0) {
+    PATTERN_STATS_GAIN_SQUARE_TIME(start);
+    return std::pair<int, int>(0, MISMATCH);
   }
 
+  const int match_index = __builtin_ctz(level_matches);
+  PATTERN_STATS_HIT(match_index);
+  int match_pos;
+  if (match_index == __builtin_ctz(matches)) {
+    match_pos = g_pattern_table.first_match_pos(window, agent_id);
+  } else {
+    /* A stronger pattern outside the level range also matches */
+    match_pos = match_pattern(board, row, col, dir,
+                              g_threat_types[match_index], g_threat_types_len[match_index], agent_id);
+  }
+
+  PATTERN_STATS_GAIN_SQUARE_TIME(start);
   return std::pair<int, int>(match_index, match_pos);
 }
 
 void Tss::set_cost_squares(
-  Position & position,
+  BitBoard & board,
   const int row,
   const int col,
   const char * pattern,
@@ -70,13 +344,11 @@ void Tss::set_cost_squares(
   const int id,
   const int dir)
 {
-  int dr = dirs[dir][0];
-  int dc = dirs[dir][1];
-  int begin_row = row - dr * match_pos,
-      begin_col = col - dc * match_pos;
-  for (int i = 0, r = begin_row, c = begin_col; i < pattern_len; i++, r += dr, c += dc) {
+  const int offset = BitBoard::geometry::offset(dir);
+  const int begin_index = board.index(row, col) - offset * match_pos;
+  for (int i = 0, index = begin_index; i < pattern_len; i++, index += offset) {
     if (pattern[i] == BLANK) {
-      position[r][c] = id;
+      board.set(index, id);
     }
   }
 }
@@ -84,7 +356,7 @@ void Tss::set_cost_squares(
 void Tss::apply_match_to_threat(
   std::pair<bool, int> & res,
   const std::pair<int, int> match,
-  Position & position,
+  BitBoard & board,
   threat_t & threat,
   const int begin, const int end,
   const int depth, const int max_depth)
@@ -93,22 +365,67 @@ void Tss::apply_match_to_threat(
   const int next_depth = depth + 1;
 
   if (match_index != 0) {
-    std::pair<bool, int> child_res = find_all_threats_at_gain_square_r(position, threat.children, begin, end, next_depth, max_depth, threat);
+    std::pair<bool, int> child_res(false, INT_MAX);
+    if (next_depth < max_depth) {
+      /* Depths in the table count from the child */
+      /* The children stay pending until the caller attaches them */
+      std::vector<threat_t> & children = m_context.m_pending;
+      const uint64_t key = TssTable::key(board.hash(), board.height(), board.width(), m_agent_id, begin, end,
+                                         board.index(threat.point.i, threat.point.j));
+      int best_gain, best_pattern;
+      const bool hit = g_tss_table_fits &&
+                       g_tss_table.probe(key, max_depth - next_depth, child_res, best_gain, best_pattern);
+      if (!hit) {
+        const int first_child = (int)children.size();
+        child_res = find_all_threats_at_gain_square_r(board, children, begin, end, next_depth, max_depth, threat);
+        if (child_res.first) {
+          child_res.second -= next_depth;
+        }
+        const int best = principal_child(children, first_child);
+        if (best >= 0) {
+          best_gain = board.index(children[best].point.i, children[best].point.j);
+          best_pattern = children[best].match_pattern;
+        } else {
+          best_gain = -1;
+          best_pattern = NO_THREAT_PATTERN;
+        }
+        if (g_tss_table_fits) {
+          g_tss_table.store(key, max_depth - next_depth, child_res, best_gain, best_pattern);
+        }
+      }
+      if (child_res.first) {
+        child_res.second += next_depth;
+        if (hit) {
+          /* A hit knows the first move of the principal line, not the rest */
+          threat_t child(point_t{BitBoard::geometry::row(best_gain), BitBoard::geometry::col(best_gain)},
+                         child_res.second == next_depth);
+          child.match_pattern = best_pattern;
+          child.match_pattern_level = g_threat_pattern_levels[best_pattern];
+          child.final_winning = true;
+          child.min_winning_depth = child_res.second;
+          children.push_back(child);
+        }
+      }
+    }
     res.first |= child_res.first;
     res.second = std::min(res.second, child_res.second);
     threat.final_winning |= child_res.first;
     threat.min_winning_depth = std::min(threat.min_winning_depth, child_res.second);
+    if (child_res.first) {
+      PATTERN_STATS_WIN(match_index);
+    }
   } else {
     res.first = true;
     res.second = depth;
     threat.winning = threat.final_winning = true;
     threat.min_winning_depth = std::min(threat.min_winning_depth, depth);
+    PATTERN_STATS_WIN(match_index);
     LOG_FAST_TSS("Winning sequence found [depth = %d]\n", depth);
   }
 }
 
 std::pair<bool, int> Tss::find_all_threats_at_gain_square_r(
-  Position & position,
+  BitBoard & board,
   std::vector<threat_t> & threats,
   const int begin, const int end,
   const int depth, const int max_depth,
@@ -122,42 +439,42 @@ std::pair<bool, int> Tss::find_all_threats_at_gain_square_r(
     return res;
   }
 
-  const int w = m_state.board_width;
-  const int h = m_state.board_height;
   const int row = dependent_threat.point.i;
   const int col = dependent_threat.point.j;
+  const int origin = board.index(row, col);
+  const auto & rays = BitBoard::geometry::rays;
 
-  const int opponent_id = m_state.agent_id ^ (1 << 0);
-  const int agent_id = m_state.agent_id;
+  const int opponent_id = m_agent_id ^ (1 << 0);
+  const int agent_id = m_agent_id;
 
   DEBUG_FAST_TSS("Start from state\n");
-  DEBUG_FAST_TSS_POSITION(position);
-
-  for (int dir = 0; dir < 8; dir++) {
-    const int dir_mod = dir % 4;
-    const int sign = (dir < 4) ? 1 : -1;
-    const int dr = dirs[dir_mod][0] * sign;
-    const int dc = dirs[dir_mod][1] * sign;
-    int i = row;
-    int j = col;
+  DEBUG_FAST_TSS_POSITION(board);
+
+  /* Deepest level still searched; TSS_PRINCIPAL_LINE lowers it to the shortest win so far */
+  int limit = max_depth;
+  for (int ray = 0; ray < NUM_RAYS && depth < limit; ray++) {
+    const int dir = rays.dir[ray];
+    const int * steps = rays.steps[ray];
     int lose = 1;
-    for (int k = 0; k < FAST_TSS_MAX_DEPENDENT_RANGE && lose >= 0; k++) {
-      if (!in_boundary(i, j, w, h)) {
-        lose = -1;
-        break;
-      }
-      if (position[i][j] == opponent_id) {
+    for (int k = 0; k < FAST_TSS_MAX_DEPENDENT_RANGE && lose >= 0 && depth < limit; k++) {
+      /* The WALL padding stops the walk at the border */
+      const int index = origin + steps[k];
+      const char cell = board.at(index);
+      if (cell == opponent_id || cell == WALL) {
         lose = -1;
         break;
       }
 
-      if (position[i][j] == EMPTY) {
-        position[i][j] = agent_id;
+      if (cell == EMPTY && !is_forbidden(board, index)) {
+        const int i = BitBoard::geometry::row(index);
+        const int j = BitBoard::geometry::col(index);
+        board.set(index, agent_id);
         threat_t child_threat(point_t{i, j}, false);
-        std::pair<int, int> child_match = is_gain_square(child_threat, position, begin, end, dir_mod, agent_id);
+        const int first_child = (int)m_context.m_pending.size();
+        std::pair<int, int> child_match = is_gain_square(child_threat, board, begin, end, dir, agent_id);
 
-        DEBUG_FAST_TSS("Move from gain(%d, %d) to (%d, %d)[0%x]; Depth = %d/%d; dir(%d, %d: %d)\n", row, col, i, j, position[i][j], depth, max_depth, dr, dc, sign);
-        DEBUG_FAST_TSS_POSITION(position);
+        DEBUG_FAST_TSS("Move from gain(%d, %d) to (%d, %d)[0%x]; Depth = %d/%d; ray %d\n", row, col, i, j, board.at(i, j), depth, max_depth, ray);
+        DEBUG_FAST_TSS_POSITION(board);
 
         if (child_match.second != MISMATCH) {
           const int match_index = child_match.first;
@@ -166,32 +483,34 @@ std::pair<bool, int> Tss::find_all_threats_at_gain_square_r(
           const int pattern_len = g_threat_types_len[match_index];
           
           if (g_threat_pattern_levels[match_index] > child_threat.match_pattern_level) {
-            child_threat.match_pattern = pattern;
+            child_threat.match_pattern = match_index;
             child_threat.match_pattern_level = g_threat_pattern_levels[match_index];
           }
 
           DEBUG_FAST_TSS("Match from gain pattern[%d] %s (at %d)\n", match_index, pattern, match_pos);
-          set_cost_squares(position, i, j, pattern, pattern_len, match_pos, opponent_id, dir_mod);
+          set_cost_squares(board, i, j, pattern, pattern_len, match_pos, opponent_id, dir);
           LOG_FAST_TSS("Gain square from gain (%d, %d) [depth = %d]; Dependent (%d, %d)\n", i, j, depth, dependent_threat.point.i, dependent_threat.point.j);
-          LOG_FAST_TSS_POSITION(position);
+          LOG_FAST_TSS_POSITION(board);
 
           apply_match_to_threat(
             res,
             child_match,
-            position,
+            board,
             child_threat,
             begin, end,
-            depth, max_depth);
+            depth, limit);
+          if (m_mode == TSS_PRINCIPAL_LINE && res.first) {
+            limit = res.second;
+          }
 
-          set_cost_squares(position, i, j, pattern, pattern_len, match_pos, EMPTY, dir_mod);
+          set_cost_squares(board, i, j, pattern, pattern_len, match_pos, EMPTY, dir);
+          attach_children(child_threat, first_child);
           threats.push_back(child_threat);
           lose--;
           DEBUG_FAST_TSS("No remain Match from gain pattern[%d] %s (at %d)\n", match_index, pattern, match_pos);
         }
-        position[i][j] = EMPTY;
+        board.set(index, EMPTY);
       }
-      i += dr;
-      j += dc;
     }
   }
   LOG_FAST_TSS("\tResult (depth = %d) = [%d, %d]\n", depth, res.first, res.second);
@@ -199,20 +518,20 @@ std::pair<bool, int> Tss::find_all_threats_at_gain_square_r(
 }
 
 std::pair<bool, int> Tss::find_all_threats_r(
-  Position & position,
+  BitBoard & board,
   std::vector<threat_t> & threats,
   const int begin,
   const int end,
   const int depth,
   const int max_depth,
-  const threat_t & dependent_threat)
+  const threat_t & dependent_threat,
+  const int top, const int left, const int bottom, const int right,
+  const uint8_t * gains)
 {
   /* No level 1, for now */
   assert(begin != THREAT_LEVEL_1 && end != THREAT_LEVEL_1);
 
-  const int w = m_state.board_width;
-  const int h = m_state.board_height;
-  const int opponent_id = m_state.agent_id ^ (1 << 0);
+  const int opponent_id = m_agent_id ^ (1 << 0);
 
   std::pair<bool, int> res;
   res.first = false;
@@ -223,17 +542,21 @@ std::pair<bool, int> Tss::find_all_threats_r(
   }
 
   DEBUG_FAST_TSS("Start from state\n");
-  DEBUG_FAST_TSS_POSITION(position);
-
-  for (int i = 0; i < h; i++) {
-    for (int j = 0; j < w; j++) {
-      DEBUG_FAST_TSS("Move (%d, %d)[0%x]; Depth = %d\n", i, j, position[i][j], depth);
-      if (position[i][j] == mcts::EMPTY) {
+  DEBUG_FAST_TSS_POSITION(board);
+
+  const int box_width = right - left + 1;
+  for (int i = top; i <= bottom; i++) {
+    for (int j = left; j <= right; j++) {
+      DEBUG_FAST_TSS("Move (%d, %d)[0%x]; Depth = %d\n", i, j, board.at(i, j), depth);
+      if (gains[(i - top) * box_width + j - left] != PatternTable::NO_PATTERN &&
+          !is_forbidden(board, board.index(i, j))) {
         threat_t child_threat(point_t{i, j}, false);
+        const int first_child = (int)m_context.m_pending.size();
+        int limit = max_depth;
 
-        position[i][j] = m_state.agent_id;
+        board.set(i, j, m_agent_id);
         for (int dir = 0; dir < 4; dir++) {
-          std::pair<int, int> match = is_gain_square(child_threat, position, begin, end, dir, m_state.agent_id);
+          std::pair<int, int> match = is_gain_square(child_threat, board, begin, end, dir, m_agent_id);
           if (match.second != MISMATCH) {
             const int match_index = match.first;
             const int match_pos = match.second;
@@ -242,26 +565,31 @@ std::pair<bool, int> Tss::find_all_threats_r(
             
             if (g_threat_pattern_levels[match_index] > child_threat.match_pattern_level) {
               child_threat.match_pattern_level = g_threat_pattern_levels[match_index];
-              child_threat.match_pattern = pattern;
+              child_threat.match_pattern = match_index;
             }
 
             DEBUG_FAST_TSS("Match pattern %s (at %d)\n", pattern, match_pos);
-            set_cost_squares(position, i, j, pattern, pattern_len, match_pos, opponent_id, dir);
+            set_cost_squares(board, i, j, pattern, pattern_len, match_pos, opponent_id, dir);
             LOG_FAST_TSS("Gain square (%d, %d) [depth = %d]; Dependent (%d, %d)\n", i, j, depth, dependent_threat.point.i, dependent_threat.point.j);
-            LOG_FAST_TSS_POSITION(position);
+            LOG_FAST_TSS_POSITION(board);
 
             apply_match_to_threat(
               res,
               match,
-              position,
+              board,
               child_threat,
               begin, end,
-              depth, max_depth);
+              depth, limit);
+            if (m_mode == TSS_PRINCIPAL_LINE && child_threat.final_winning) {
+              /* Later lines only matter for the level or a shorter win */
+              limit = child_threat.min_winning_depth;
+            }
 
-            set_cost_squares(position, i, j, pattern, pattern_len, match_pos, EMPTY, dir);    
+            set_cost_squares(board, i, j, pattern, pattern_len, match_pos, EMPTY, dir);    
           }
        }
-       position[i][j] = EMPTY;
+       board.set(i, j, EMPTY);
+       attach_children(child_threat, first_child);
        if (child_threat.match_pattern_level > 0) {
         threats.push_back(child_threat);
        }
@@ -11,7 +11,12 @@
 #include "board.h"
 #include "constants.h"
 #include "state.h"
+#include "threat_cache.h"
+#include "tss_table.h"
+#include "thread_pool.h"
 #include "pattern.h"
+#include "pattern_stats.h"
+#include "renju.h"
 #include "util.h"
 #include "debug.h"
 
@@ -31,11 +36,35 @@
 #define THREAT_LEVEL_5 4
 #define RANDOM_SEARCH_RANGE 2
 
+/*
+ * What a search keeps below the threats it returns. Either way a gain
+ * square answered from tss_table() keeps only the first move of its
+ * principal line, so the trees depend on what the table holds.
+ */
+#define TSS_FULL_TREE 0
+/*
+ * Only the shortest winning line below each threat; a branch stops once
+ * it cannot find a shorter win. The threats themselves are the same.
+ */
+#define TSS_PRINCIPAL_LINE 1
+/*
+ * Or'ed into either mode: the root cells are searched on tss_pool(), each
+ * worker on its own context. The threats, with their levels, wins and
+ * depths, come out as in a serial search; the trees below them depend on
+ * which worker reaches a table entry first and may change from run to run.
+ */
+#define TSS_PARALLEL 2
+
+/* Workers of tss_pool(), 0 for one per hardware thread */
+#ifndef TSS_THREADS
+#define TSS_THREADS 0
+#endif
+
 namespace mcts
 {
 class State;
 
-const static char * g_threat_types[] = {
+constexpr const char * g_threat_types[] = {
   /* Five */
   "ooooo", // 0
 
@@ -67,30 +96,19 @@ const static char * g_threat_types[] = {
   "____o"  // 19
 };
 
-const static int g_threat_types_len[] = {
-  sizeof  "ooooo"  - 1, // 0
-  sizeof  "oooo_"  - 1, // 1
-  sizeof  "ooo_o"  - 1, // 2
-  sizeof  "oo_oo"  - 1, // 3
-  sizeof  "o_ooo"  - 1, // 4
-  sizeof  "_oooo"  - 1, // 5
-  sizeof  "x_ooo__" - 1,  // 6
-  sizeof  "__ooo_x" - 1,  // 7
-  sizeof  "_ooo_"  - 1,   // 8
-  sizeof  "_o_oo_" - 1, // 9
-  sizeof  "_oo_o_" - 1, // 10
-  sizeof  "oo___"  - 1, // 11
-  sizeof  "_oo__"  - 1, // 12
-  sizeof  "__oo_"  - 1, // 13
-  sizeof  "___oo"  - 1, // 14
-  sizeof  "o____"  - 1, // 15
-  sizeof  "_o___"  - 1, // 16
-  sizeof  "__o__"  - 1, // 17
-  sizeof  "___o_"  - 1, // 18
-  sizeof  "____o"  - 1  // 19
-};
+constexpr int g_threat_types_num = sizeof(g_threat_types) / sizeof(char *);
 
-const static int g_threat_pattern_levels[] = {
+static_assert(g_threat_types_num <= PATTERN_MAX_PATTERNS, "too many threat patterns");
+
+/*
+ * Automaton of g_threat_types, generated by the compiler: editing the
+ * list above costs nothing at run time
+ */
+constexpr pattern_automaton_t g_threat_automaton = make_pattern_automaton(g_threat_types, g_threat_types_num);
+
+constexpr const int * g_threat_types_len = g_threat_automaton.lengths;
+
+constexpr int g_threat_pattern_levels[] = {
   5,
   4,
   4,
@@ -113,7 +131,7 @@ const static int g_threat_pattern_levels[] = {
   1
 };
 
-const static int g_threat_levels[][2] = {
+constexpr int g_threat_levels[][2] = {
     /* Level 1 */
     {19, 15},
     /* Level 2 */
@@ -126,21 +144,196 @@ const static int g_threat_levels[][2] = {
     {0, 0}
 };
 
-const static int g_threat_types_num = sizeof(g_threat_types) / sizeof(char *);
+static_assert(sizeof(g_threat_pattern_levels) / sizeof(int) == g_threat_types_num,
+              "every threat pattern needs a level");
+
+/*
+ * @brief window lookup table of g_threat_types, mapped from
+ *        PATTERN_TABLE_FILE or generated on first use
+ * */
+const PatternTable & threat_pattern_table();
+
+/*
+ * @brief results of the searches below gain squares, shared by all Tss
+ * */
+TssTable & tss_table();
 
 /*
- * Vertical,
- * Horizontal,
- * Diagonal-Up,
- * Diagonal-Bottom
+ * Scratch space of the threat searches: the board they play on, the
+ * moves made on it, the gain square buffers, the arena of the threat
+ * trees they build and the threat levels of the last board asked about.
+ * Reused from call to call, so a search allocates nothing once the
+ * buffers have grown; one per thread, see tss_context().
  */
-const static int dirs[4][2] = {
-    {  1, 0 },
-    {  0, 1 },
-    {  1, 1 },
-    { -1, 1 }
+class TssContext
+{
+public:
+  TssContext();
+
+  TssContext(const TssContext &) = delete;
+  TssContext & operator=(const TssContext &) = delete;
+
+  /*
+   * @brief start over from a copy of board, with no moves made
+   *        the Tss calls taking no board load the context themselves, so
+   *        they must not run while a caller has moves made on it
+   * */
+  BitBoard & load(const BitBoard & board);
+
+  BitBoard & board()
+  {
+    return m_board;
+  }
+
+  void make(int index, char agent_id)
+  {
+    assert(m_board.at(index) == EMPTY);
+    m_board.set(index, agent_id);
+    m_moves.push_back(index);
+  }
+
+  void unmake()
+  {
+    m_board.set(m_moves.back(), EMPTY);
+    m_moves.pop_back();
+  }
+
+  /*
+   * @brief buffer of at least size cells for the gain squares of agent_id
+   * */
+  uint8_t * gains(int agent_id, int size)
+  {
+    if ((int)m_gains[agent_id].size() < size) {
+      m_gains[agent_id].resize(size);
+    }
+    return m_gains[agent_id].data();
+  }
+
+  /*
+   * @brief threats below the threats found since load(), the children of
+   *        each side by side; cleared by load()
+   * */
+  const std::vector<threat_t> & tree() const
+  {
+    return m_tree;
+  }
+
+  /*
+   * @brief print threat and the tree below it
+   * */
+  void print(const threat_t & threat, int depth = 0) const;
+
+  /*
+   * @brief threat levels of board, rebuilt when board is not the board
+   *        of the previous call; valid until the next call
+   * */
+  const ThreatCache & threat_cache(const BitBoard & board);
+
+private:
+  friend class Tss;
+
+  BitBoard m_board;
+  std::vector<int> m_moves;
+  std::vector<uint8_t> m_gains[2];
+  std::vector<threat_t> m_tree;
+  /* Children found so far by the levels of the search in progress */
+  std::vector<threat_t> m_pending;
+  /* Levels of the board with this hash and size, none before the first use */
+  ThreatCache m_threat_cache;
+  uint64_t m_cache_hash;
+  int m_cache_height;
+  int m_cache_width;
+
+  /*
+   * @brief append the nodes [begin, end) of another context's tree, whose
+   *        children all lie within the range
+   * @return the offset to add to the first_child of their parent
+   * */
+  int append_tree(const std::vector<threat_t> & tree, int begin, int end)
+  {
+    const int offset = (int)m_tree.size() - begin;
+    for (int k = begin; k < end; k++) {
+      m_tree.push_back(tree[k]);
+      m_tree.back().first_child += offset;
+    }
+    return offset;
+  }
+
+  /*
+   * @brief nodes of the tree below threat, all on one line when every
+   *        level kept only its principal child
+   * */
+  int line_size(const threat_t & threat) const
+  {
+    int size = 0;
+    for (const threat_t * node = &threat; node->num_children; node = &m_tree[node->first_child]) {
+      size++;
+    }
+    return size;
+  }
+
+  /*
+   * @brief drop the pending threats from first_pending on, all but the
+   *        first one starting the shortest win, together with their lines;
+   *        those lines end the tree, one after another in pending order
+   * */
+  void keep_principal_child(int first_pending)
+  {
+    int best = -1;
+    int first_node = (int)m_tree.size();
+    for (int k = first_pending; k < (int)m_pending.size(); k++) {
+      first_node -= line_size(m_pending[k]);
+      if (m_pending[k].final_winning && (best < 0 || m_pending[k].min_winning_depth < m_pending[best].min_winning_depth)) {
+        best = k;
+      }
+    }
+    if (best >= 0) {
+      /* The line of the kept threat moves down over the dropped ones */
+      threat_t child = m_pending[best];
+      const int size = line_size(child);
+      if (size) {
+        const int shift = child.first_child + 1 - size - first_node;
+        for (int k = first_node; k < first_node + size; k++) {
+          m_tree[k] = m_tree[k + shift];
+          m_tree[k].first_child -= shift;
+        }
+        child.first_child -= shift;
+      } else {
+        child.first_child = first_node;
+      }
+      m_tree.resize(first_node + size);
+      m_pending[first_pending] = child;
+      m_pending.resize(first_pending + 1);
+    } else {
+      m_tree.resize(first_node);
+      m_pending.resize(first_pending);
+    }
+  }
+
+  /*
+   * @brief move the pending threats from first_pending on into the tree,
+   *        as the children of parent; fast_tss.cpp bounds their number
+   * */
+  void attach_children(threat_t & parent, int first_pending)
+  {
+    assert((int)m_pending.size() - first_pending <= UINT8_MAX);
+    parent.first_child = (int)m_tree.size();
+    parent.num_children = (uint8_t)(m_pending.size() - first_pending);
+    m_tree.insert(m_tree.end(), m_pending.begin() + first_pending, m_pending.end());
+    m_pending.resize(first_pending);
+  }
 };
 
+/*
+ * @brief TssContext of the calling thread
+ * */
+TssContext & tss_context();
+
+/*
+ * @brief workers of the TSS_PARALLEL searches, started on first use
+ * */
+ThreadPool & tss_pool();
+
 /*
  * Construct with a state.
  * After construction, we can get all threats by calling get_threats()
@@ -150,32 +343,92 @@ class Tss
 {
 public:
   Tss(const State & state);
+  /* Search the threats of agent_id instead of the side of state */
+  Tss(const State & state, int agent_id);
   ~Tss();
 
-  int find_all_threats(std::vector<threat_t> & threats, int begin_level, int end_level, int max_depth);
-  int find_all_threats(const Position & position, std::vector<threat_t> & threats, int begin_level, int end_level, int max_depth);
+  /*
+   * @param[IN] mode TSS_FULL_TREE or TSS_PRINCIPAL_LINE, either with TSS_PARALLEL
+   * */
+  int find_all_threats(std::vector<threat_t> & threats, int begin_level, int end_level, int max_depth, int mode = TSS_FULL_TREE);
+  int find_all_threats(const BitBoard & board, std::vector<threat_t> & threats, int begin_level, int end_level, int max_depth,
+                       int mode = TSS_FULL_TREE);
   std::pair<bool, int> find_all_threats_at(const threat_t & dependent_threat, std::vector<threat_t> & threats, int begin_level, int end_level, int max_depth);
+  /*
+   * @brief find_all_threats_at() on board as it is instead of the board of
+   *        the state, e.g. a TssContext board after make()
+   * */
+  std::pair<bool, int> find_all_threats_at(
+    BitBoard & board, const threat_t & dependent_threat, std::vector<threat_t> & threats, int begin_level, int end_level, int max_depth);
+
+  /*
+   * @brief find_all_threats() for both colors of state, from a single pass
+   *        of PatternTable::scan(); threats[agent_id] gets the threats of agent_id
+   * */
+  static void find_all_threats_both(
+    const State & state, std::vector<threat_t> threats[2], int begin_level, int end_level, int max_depth,
+    int mode = TSS_FULL_TREE);
+  /*
+   * @brief find_all_threats_both() with its TSS_PARALLEL search on pool
+   *        instead of tss_pool()
+   * */
+  static void find_all_threats_both(
+    const State & state, std::vector<threat_t> threats[2], int begin_level, int end_level, int max_depth,
+    int mode, ThreadPool & pool);
 private:
   const State & m_state;
+  const int m_agent_id;
+  TssContext & m_context;
+  /* TSS_FULL_TREE or TSS_PRINCIPAL_LINE of the search in progress */
+  int m_mode;
 
   std::pair<bool, int> find_all_threats_r(
-    Position & state_position,
+    BitBoard & board,
     std::vector<threat_t> & threats,
     const int begin, const int end,
     const int depth, const int max_depth,
-    const threat_t & dependent_threat);
+    const threat_t & dependent_threat,
+    const int top, const int left, const int bottom, const int right,
+    const uint8_t * gains);
+
+  /*
+   * @brief find_all_threats_r() from the root on board, loaded in
+   *        m_context, one task of
+   *        pool per cell of the box with a gain square; the threats
+   *        and their trees are merged into m_context in row order
+   * */
+  void find_all_threats_parallel(
+    ThreadPool & pool,
+    BitBoard & board,
+    std::vector<threat_t> & threats,
+    const int begin, const int end,
+    const int max_depth,
+    const int top, const int left, const int bottom, const int right,
+    const uint8_t * gains);
 
   std::pair<bool, int> find_all_threats_at_gain_square_r(
-    Position & position,
+    BitBoard & board,
     std::vector<threat_t> & threats,
     const int begin, const int end,
     const int depth, const int max_depth,
     const threat_t & dependent_threat);
 
-  std::pair<int, int> is_gain_square(const threat_t & threat, const Position & position, int begin, int end, int dir, int agent_id);
+  std::pair<int, int> is_gain_square(const threat_t & threat, const BitBoard & board, int begin, int end, int dir, int agent_id);
+
+  /*
+   * @brief whether the rules forbid the attacker to play at index
+   * */
+  bool is_forbidden(const BitBoard & board, int index) const
+  {
+#ifdef _RENJU
+    return m_agent_id == BLACK && renju_is_forbidden(board, index);
+#else
+    return false;
+#endif
+  }
 
   void set_cost_squares(
-    Position & position,
+    BitBoard & board,
     const int row,
     const int col,
     const char * pattern,
@@ -184,10 +437,22 @@ private:
     const int id,
     const int dir);
 
+  /*
+   * @brief attach the children threat got from first_child on, only its
+   *        principal one under TSS_PRINCIPAL_LINE
+   * */
+  void attach_children(threat_t & threat, int first_child)
+  {
+    if (m_mode == TSS_PRINCIPAL_LINE) {
+      m_context.keep_principal_child(first_child);
+    }
+    m_context.attach_children(threat, first_child);
+  }
+
   void apply_match_to_threat(
     std::pair<bool, int> & res,
     const std::pair<int, int> match,
-    Position & position,
+    BitBoard & board,
     threat_t & threat,
     const int begin, const int end,
     const int depth, const int max_depth);
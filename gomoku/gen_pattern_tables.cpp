@@ -0,0 +1,19 @@
+#include <cstdio>
+
+#include "fast_tss.h"
+
+/*
+ * Writes the threat pattern tables the engine maps at startup, so that
+ * processes skip generating them and share the pages
+ * usage: gen_pattern_tables [path], PATTERN_TABLE_FILE by default
+ */
+int main(int argc, char * argv[])
+{
+  const char * path = (argc > 1) ? argv[1] : PATTERN_TABLE_FILE;
+  const PatternTable table(mcts::g_threat_automaton);
+  if (!table.save(path)) {
+    fprintf(stderr, "cannot write %s\n", path);
+    return 1;
+  }
+  return 0;
+}
@@ -13,9 +13,10 @@
 #include "state.h"
 #include "util.h"
 
-bool check_ai_play(int mode, char& turn, mcts::Position& position);
-void play_by_ai(char turn, mcts::Position& position);
-bool check_game_finished(mcts::Position& position);
+bool check_ai_play(int mode, char& turn, mcts::Position& position,
+                   mcts::point_t& point);
+void play_by_ai(char turn, mcts::Position& position, mcts::point_t& point);
+bool check_game_finished(mcts::Position& position, int row = -1, int col = -1);
 void print_status(int mode, char turn, int move_num,
                   mcts::Position& position);
 void split_string(const std::string& input, std::vector<std::string>& tokens);
@@ -26,8 +27,8 @@ const int kModeAiBlack = 2;
 const int kModeHumanAll = 3;
 const int kModeAiAll = 4;
 
-const int kHeight = 15;
-const int kWidth = 15;
+const int kHeight = mcts::geometry_t::size;
+const int kWidth = mcts::geometry_t::size;
 const unsigned kMaxDuration = 9500; // In milliseconds
 const unsigned kMaxIterationCount = 1000;
 const double kExplore = 1.41;
@@ -97,7 +98,7 @@ int main(int argc, char* argv[])
                 mcts::print_position(std::cout, position);
               }
               print_status(mode, turn, move_num, position);
-              if (check_game_finished(position)) {
+              if (check_game_finished(position, row, col)) {
                 is_game_finished = true;
               }
             }
@@ -174,14 +175,16 @@ int main(int argc, char* argv[])
         std::cerr << "Enter 'help' to see list of commands" << '\n';
       }
     }
+    mcts::point_t ai_point;
     if (!is_game_finished &&
-        check_ai_play(mode, turn, position)) {
+        check_ai_play(mode, turn, position, ai_point)) {
       move_num += 1;
       history.push_back(position);
       mcts::print_position(std::cout, position);
       std::cout << '\n';
       print_status(mode, turn, move_num, position);
-      if (check_game_finished(position)) {
+      // find_position_diff keeps the row in j and the column in i
+      if (check_game_finished(position, ai_point.j, ai_point.i)) {
         is_game_finished = true;
       }
     }
@@ -191,12 +194,13 @@ int main(int argc, char* argv[])
   return 0;
 }
 
-bool check_ai_play(int mode, char& turn, mcts::Position& position)
+bool check_ai_play(int mode, char& turn, mcts::Position& position,
+                   mcts::point_t& point)
 {
   if ((mode == kModeAiBlack && turn == mcts::BLACK) ||
       (mode == kModeAiWhite && turn == mcts::WHITE) ||
       (mode == kModeAiAll)) {
-    play_by_ai(turn, position);
+    play_by_ai(turn, position, point);
     turn = !turn;
     return true;
   } else {
@@ -204,7 +208,7 @@ bool check_ai_play(int mode, char& turn, mcts::Position& position)
   }
 }
 
-void play_by_ai(char turn, mcts::Position& position)
+void play_by_ai(char turn, mcts::Position& position, mcts::point_t& point)
 {
   mcts::Timer timer(kMaxDuration, kMaxIterationCount);
   mcts::MCTS mcts(&timer, kExplore, kVerbose);
@@ -212,16 +216,20 @@ void play_by_ai(char turn, mcts::Position& position)
   mcts::State result_state(kHeight, kWidth, mcts::EMPTY);
   mcts.run(root_state, result_state);
   // Print the stone AI placed
-  mcts::point_t point;
-  find_position_diff(position, result_state.position, point);
+  mcts::Position result_position;
+  result_state.get_position(result_position);
+  find_position_diff(position, result_position, point);
   std::cout << "AI placed " << (char)('A' + point.j) << point.i << '\n';
-  position = result_state.position;
+  position = result_position;
 }
 
-bool check_game_finished(mcts::Position& position)
+/*
+ * @brief report the winner, if any; (row, col) is the stone just placed,
+ *        which limits the check to the lines through it
+ * */
+bool check_game_finished(mcts::Position& position, int row, int col)
 {
-  mcts::State state(kHeight, kWidth, position, mcts::EMPTY);
-  char winner = sim_check_win(state);
+  char winner = mcts::sim_check_win(position, row, col);
   if (winner == NOT_END) {
     return false;
   } else {
@@ -1,4 +1,18 @@
 #include "pattern.h"
+#include "pattern_stats.h"
+
+#include <string>
+
+#ifdef PATTERN_SCAN_AVX2
+#include <immintrin.h>
+#endif
+
+#ifdef _UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 bool match_pattern_position(char type, int chess, int agent_id)
 {
@@ -18,42 +32,340 @@ bool match_pattern_position(char type, int chess, int agent_id)
 }
 
 int match_pattern(
-  const std::vector<std::vector<char>> & position,
-  int row, int col, int w, int h, int dr, int dc,
+  const mcts::BitBoard & board,
+  int row, int col, int dir,
   const char * pattern, int pattern_len,
   int agent_id)
 {
-  DEBUG_PATTERN("match_pattern(%d, %d) = %s : len = %d\n", dr, dc, pattern, pattern_len);
-  for (int cursor = 0; cursor < pattern_len; cursor++) {
-    int begin_row = row - cursor * dr;
-    int begin_col = col - cursor * dc;
+  DEBUG_PATTERN("match_pattern(%d) = %s : len = %d\n", dir, pattern, pattern_len);
+  assert(pattern_len <= mcts::BitBoard::geometry::pad + 1);
+
+  const int * forward = mcts::BitBoard::geometry::rays.steps[dir];
+  const int * backward = mcts::BitBoard::geometry::rays.steps[dir + NUM_DIR];
+  const int center = board.index(row, col);
 
-    DEBUG_PATTERN("Begin at (%d, %d) End at (%d, %d)\n", begin_row, begin_col,
-                  end_row, end_col);
+  for (int cursor = 0; cursor < pattern_len; cursor++) {
+    const int begin = center + backward[cursor];
 
     int result = cursor;
     for (int i = 0; i < pattern_len; i++) {
-      char type = pattern[i];
-      int cur_row = begin_row + dr * i;
-      int cur_col = begin_col + dc * i;
-
-      if (!in_boundary(cur_row, cur_col, w, h)) {
-        result = MISMATCH;
-        break;
-      }
-
-      if (!match_pattern_position(type, position[cur_row][cur_col], agent_id)) {
+      if (!match_pattern_position(pattern[i], board.at(begin + forward[i]), agent_id)) {
         result = MISMATCH;
         break;
       }
 
-      DEBUG_PATTERN("Match 0x%x (%c) [%d, %d]\n", position[cur_row][cur_col], type, cur_row, cur_col);
+      DEBUG_PATTERN("Match 0x%x (%c) [%d]\n", board.at(begin + forward[i]), pattern[i], i);
     }
 
     if (result != MISMATCH) {
-      DEBUG_PATTERN("Match %s (%d, %d) -> (%d, %d)\n", pattern, begin_row, begin_col, end_row, end_col);
+      DEBUG_PATTERN("Match %s (%d, %d) at %d\n", pattern, row, col, cursor);
       return cursor;
     }
   }
   return MISMATCH;
 }
+
+/* FNV-1a */
+static uint64_t hash_bytes(const void * data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+  const unsigned char * bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/* FNV-1a on two entries at a time, to check a mapped file quickly */
+static uint64_t hash_entries(const uint32_t * entries, size_t count, uint64_t hash)
+{
+  for (size_t i = 0; i + 1 < count; i += 2) {
+    hash = (hash ^ (entries[i] | ((uint64_t)entries[i + 1] << 32))) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+PatternTable::PatternTable(const pattern_automaton_t & automaton, const char * path):
+  m_mapping(NULL),
+  m_mapping_size(0),
+  m_signature(hash_bytes(&automaton, sizeof(automaton)))
+{
+  assert(automaton.num_patterns <= POS_SHIFT);
+
+  if (path == NULL || !map(path)) {
+    generate(automaton);
+    m_entries[0] = m_storage.data();
+    m_entries[1] = m_storage.data() + (1U << KEY_BITS);
+  }
+}
+
+PatternTable::~PatternTable()
+{
+#ifdef _UNIX
+  if (m_mapping) {
+    munmap(m_mapping, m_mapping_size);
+  }
+#endif
+}
+
+void PatternTable::generate(const pattern_automaton_t & automaton)
+{
+  m_storage.assign(2U << KEY_BITS, 0);
+  for (int agent_id = 0; agent_id < 2; agent_id++) {
+    uint32_t * entries = &m_storage[agent_id << KEY_BITS];
+
+    for (unsigned key = 0; key < (1U << KEY_BITS); key++) {
+      /* Cells -WINDOW_RADIUS .. WINDOW_RADIUS, the center holding agent_id */
+      int symbols[WINDOW_CELLS];
+      for (int k = 0, bits = 0; k < WINDOW_CELLS; k++) {
+        if (k == WINDOW_RADIUS) {
+          symbols[k] = SYMBOL_SELF;
+        } else {
+          symbols[k] = cell_symbol((key >> (2 * bits++)) & 0x3, agent_id);
+        }
+      }
+
+      /* Occurrences covering the center, with the center's lowest offset */
+      uint32_t matches = 0;
+      int cursors[PATTERN_MAX_PATTERNS];
+      automaton.scan(symbols, WINDOW_CELLS, [&](int id, int end) {
+        const int cursor = WINDOW_RADIUS - (end - automaton.lengths[id] + 1);
+        if (cursor >= 0 && end >= WINDOW_RADIUS) {
+          /* Later occurrences put the center earlier in the pattern */
+          matches |= 1U << id;
+          cursors[id] = cursor;
+        }
+      });
+
+      uint32_t entry = matches;
+      if (matches) {
+        entry |= (uint32_t)cursors[__builtin_ctz(matches)] << POS_SHIFT;
+      }
+      entries[key] = entry;
+    }
+  }
+}
+
+void PatternTable::fill_header(file_header_t & header) const
+{
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "GMKPTAB", sizeof(header.magic));
+  header.version = PATTERN_TABLE_VERSION;
+  header.rule = PATTERN_TABLE_RULE;
+  header.key_bits = KEY_BITS;
+  header.entry_size = sizeof(uint32_t);
+  header.signature = m_signature;
+  header.checksum = hash_entries(m_entries[0], 1U << KEY_BITS, m_signature);
+  header.checksum = hash_entries(m_entries[1], 1U << KEY_BITS, header.checksum);
+}
+
+bool PatternTable::save(const char * path) const
+{
+  file_header_t header;
+  fill_header(header);
+
+  /* Readers never see a half-written file */
+  const std::string tmp_path = std::string(path) + ".tmp";
+  FILE * file = fopen(tmp_path.c_str(), "wb");
+  if (file == NULL) {
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (int agent_id = 0; agent_id < 2 && ok; agent_id++) {
+    ok = fwrite(m_entries[agent_id], sizeof(uint32_t), 1U << KEY_BITS, file) == (1U << KEY_BITS);
+  }
+  ok = (fclose(file) == 0) && ok;
+  if (!ok || rename(tmp_path.c_str(), path) != 0) {
+    remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool PatternTable::map(const char * path)
+{
+#ifdef _UNIX
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  const size_t size = sizeof(file_header_t) + (sizeof(uint32_t) << (KEY_BITS + 1));
+  void * mapping = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size == size) {
+    mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  /* Point at the file, then reject it unless the header matches */
+  const uint32_t * entries = (const uint32_t *)((const char *)mapping + sizeof(file_header_t));
+  m_entries[0] = entries;
+  m_entries[1] = entries + (1U << KEY_BITS);
+  file_header_t expected;
+  fill_header(expected);
+  if (memcmp(mapping, &expected, sizeof(expected)) != 0) {
+    munmap(mapping, size);
+    return false;
+  }
+  m_mapping = mapping;
+  m_mapping_size = size;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void PatternTable::scan(const mcts::BitBoard & board, int agent_id, uint32_t id_mask,
+                        int top, int left, int bottom, int right, uint8_t * best_ids) const
+{
+  uint8_t * agent_ids[2] = { NULL, NULL };
+  agent_ids[agent_id] = best_ids;
+  scan(board, id_mask, top, left, bottom, right, agent_ids);
+}
+
+void PatternTable::scan(const mcts::BitBoard & board, uint32_t id_mask,
+                        int top, int left, int bottom, int right, uint8_t * best_ids[2]) const
+{
+  PATTERN_STATS_CLOCK(start);
+#ifdef PATTERN_SCAN_AVX2
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    scan_rows_avx2(board, id_mask, top, left, bottom, right, best_ids);
+  } else {
+    scan_rows(board, id_mask, top, left, bottom, right, best_ids);
+  }
+#else
+  scan_rows(board, id_mask, top, left, bottom, right, best_ids);
+#endif
+#ifdef _PATTERN_STATS
+  /* Counted after the clock stops */
+  const uint64_t nanos = mcts::pattern_stats_clock() - start;
+  const int box_area = (bottom - top + 1) * (right - left + 1);
+  int cells = 0;
+  int gains = 0;
+  for (int agent_id = 0; agent_id < 2; agent_id++) {
+    if (best_ids[agent_id] == NULL) {
+      continue;
+    }
+    cells += box_area;
+    for (int k = 0; k < box_area; k++) {
+      if (best_ids[agent_id][k] != NO_PATTERN) {
+        PATTERN_STATS_ROOT(best_ids[agent_id][k]);
+        gains++;
+      }
+    }
+  }
+  mcts::pattern_stats_root_scan(cells, gains, nanos);
+#endif
+}
+
+void PatternTable::scan_cell(const mcts::BitBoard & board, uint32_t id_mask, int i, int j,
+                             int k, uint8_t * best_ids[2]) const
+{
+  int best_id[2] = { NO_PATTERN, NO_PATTERN };
+  if (board.at(i, j) == mcts::EMPTY) {
+    for (int dir = 0; dir < NUM_DIR; dir++) {
+      const unsigned window_key = key(board.window(i, j, dir));
+      for (int agent_id = 0; agent_id < 2; agent_id++) {
+        const uint32_t matches = m_entries[agent_id][window_key] & id_mask;
+        if (matches) {
+          best_id[agent_id] = std::min(best_id[agent_id], __builtin_ctz(matches));
+        }
+      }
+    }
+  }
+  for (int agent_id = 0; agent_id < 2; agent_id++) {
+    if (best_ids[agent_id]) {
+      best_ids[agent_id][k] = best_id[agent_id];
+    }
+  }
+}
+
+void PatternTable::scan_rows(const mcts::BitBoard & board, uint32_t id_mask,
+                             int top, int left, int bottom, int right, uint8_t * best_ids[2]) const
+{
+  const int box_width = right - left + 1;
+  for (int i = top; i <= bottom; i++) {
+    for (int j = left; j <= right; j++) {
+      scan_cell(board, id_mask, i, j, (i - top) * box_width + j - left, best_ids);
+    }
+  }
+}
+
+#ifdef PATTERN_SCAN_AVX2
+/*
+ * Four cells of a row per step: the line codes of the four cells are
+ * shifted to their windows in 64-bit lanes, turned into table keys and
+ * gathered from the table of each color; the lowest match comes out of
+ * the float exponent of the isolated lowest bit. SSE2 has neither
+ * variable shifts nor gathers, so CPUs without AVX2 take the scalar loop.
+ */
+__attribute__((target("avx2")))
+void PatternTable::scan_rows_avx2(const mcts::BitBoard & board, uint32_t id_mask,
+                                  int top, int left, int bottom, int right, uint8_t * best_ids[2]) const
+{
+  typedef mcts::geometry_t geometry;
+  const __m256i window_mask = _mm256_set1_epi64x(WINDOW_MASK);
+  const __m256i low_mask = _mm256_set1_epi64x((1 << (2 * WINDOW_RADIUS)) - 1);
+  const __m128i matches_mask = _mm_set1_epi32(id_mask & MATCHES_MASK);
+  const __m128i no_pattern = _mm_set1_epi32(NO_PATTERN);
+  const __m256i lane_cols = _mm256_set_epi64x(3, 2, 1, 0);
+  const int box_width = right - left + 1;
+
+  for (int i = top; i <= bottom; i++) {
+    const int row_begin = (i - top) * box_width - left;
+    int j = left;
+    for (; j + 3 <= right; j += 4) {
+      __m128i best[2] = { no_pattern, no_pattern };
+      for (int dir = 0; dir < NUM_DIR; dir++) {
+        const uint64_t * lines = board.line_codes(dir);
+        __m256i codes, shifts;
+        if (dir == 1) {
+          /* One row, four positions along it */
+          codes = _mm256_set1_epi64x(lines[geometry::line(dir, i, j)]);
+        } else {
+          /* Four consecutive lines */
+          codes = _mm256_loadu_si256((const __m256i *)(lines + geometry::line(dir, i, j)));
+        }
+        if (dir == 0) {
+          shifts = _mm256_set1_epi64x(2 * i);
+        } else {
+          shifts = _mm256_slli_epi64(_mm256_add_epi64(_mm256_set1_epi64x(j), lane_cols), 1);
+        }
+        const __m256i windows = _mm256_and_si256(_mm256_srlv_epi64(codes, shifts), window_mask);
+        /* Drop the center cell */
+        const __m256i keys = _mm256_or_si256(
+          _mm256_and_si256(windows, low_mask),
+          _mm256_slli_epi64(_mm256_srli_epi64(windows, 2 * WINDOW_RADIUS + 2), 2 * WINDOW_RADIUS));
+        for (int agent_id = 0; agent_id < 2; agent_id++) {
+          if (best_ids[agent_id] == NULL) {
+            continue;
+          }
+          const int * entries = (const int *)m_entries[agent_id];
+          const __m128i matches = _mm_and_si128(_mm256_i64gather_epi32(entries, keys, 4), matches_mask);
+          const __m128i lowest = _mm_and_si128(matches, _mm_sub_epi32(_mm_setzero_si128(), matches));
+          const __m128i exponent = _mm_srli_epi32(_mm_castps_si128(_mm_cvtepi32_ps(lowest)), 23);
+          const __m128i id = _mm_sub_epi32(exponent, _mm_set1_epi32(127));
+          const __m128i none = _mm_cmpeq_epi32(matches, _mm_setzero_si128());
+          best[agent_id] = _mm_min_epu32(best[agent_id], _mm_blendv_epi8(id, no_pattern, none));
+        }
+      }
+      for (int agent_id = 0; agent_id < 2; agent_id++) {
+        if (best_ids[agent_id] == NULL) {
+          continue;
+        }
+        uint32_t ids[4];
+        _mm_storeu_si128((__m128i *)ids, best[agent_id]);
+        for (int k = 0; k < 4; k++) {
+          best_ids[agent_id][row_begin + j + k] = (board.at(i, j + k) == mcts::EMPTY) ? ids[k] : NO_PATTERN;
+        }
+      }
+    }
+    for (; j <= right; j++) {
+      scan_cell(board, id_mask, i, j, row_begin + j, best_ids);
+    }
+  }
+}
+#endif
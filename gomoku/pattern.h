@@ -6,8 +6,10 @@
 #define BLANK '_'
 #define MISMATCH -1
 
+#include <cstdint>
 #include <vector>
 
+#include "bitboard.h"
 #include "constants.h"
 #include <cassert>
 #include <cstring>
@@ -18,10 +20,285 @@
 
 bool match_pattern_position(char type, int chess, int agent_id);
 
+/*
+ * @brief match pattern through (row, col) along BOARD_DIRS[dir]
+ * @return offset of (row, col) in pattern, or MISMATCH
+ * */
 int match_pattern(
-  const std::vector<std::vector<char>> & position,
-  int row, int col, int w, int h, int dr, int dc,
+  const mcts::BitBoard & board,
+  int row, int col, int dir,
   const char * pattern, int pattern_len,
   int agent_id);
 
+/* Pattern alphabet of the automaton */
+#define PATTERN_SYMBOLS 4
+#define SYMBOL_SELF 0
+#define SYMBOL_OPPONENT 1
+#define SYMBOL_EMPTY 2
+#define SYMBOL_WALL 3
+
+#define PATTERN_MAX_STATES 256
+#define PATTERN_MAX_PATTERNS 24
+
+constexpr int pattern_length(const char * pattern)
+{
+  return (*pattern) ? 1 + pattern_length(pattern + 1) : 0;
+}
+
+constexpr int pattern_symbol(char type)
+{
+  return (type == SELF) ? SYMBOL_SELF : (type == FORBBIDEN) ? SYMBOL_OPPONENT : SYMBOL_EMPTY;
+}
+
+/*
+ * @brief symbol of a cell (BLACK, WHITE, EMPTY or WALL) seen by agent_id
+ * */
+inline int cell_symbol(int cell, int agent_id)
+{
+  return (cell == mcts::BLACK || cell == mcts::WHITE) ? (cell ^ agent_id) : cell;
+}
+
+/*
+ * Deterministic Aho-Corasick automaton of a pattern list over
+ * {self, opponent, empty, wall}: one transition per cell, and every
+ * state knows all patterns ending there, so a single pass over a line
+ * reports every occurrence of every pattern.
+ * Built by make_pattern_automaton(), at compile time for constexpr lists.
+ */
+struct pattern_automaton_t
+{
+  int num_states;
+  int num_patterns;
+  int lengths[PATTERN_MAX_PATTERNS];
+  int next[PATTERN_MAX_STATES][PATTERN_SYMBOLS];
+  /* Bit k set when pattern k ends at the state */
+  uint32_t hits[PATTERN_MAX_STATES];
+
+  /*
+   * @brief on_hit(id, end) for every pattern occurrence in symbols[0 .. n),
+   *        end being the position of its last cell
+   * */
+  template <class Func>
+  void scan(const int * symbols, int n, Func on_hit) const
+  {
+    int state = 0;
+    for (int k = 0; k < n; k++) {
+      state = next[state][symbols[k]];
+      for (uint32_t found = hits[state]; found; found &= found - 1) {
+        on_hit(__builtin_ctz(found), k);
+      }
+    }
+  }
+
+  /*
+   * @brief scan a packed line code (BasicBitBoard::line_codes) of length
+   *        cells for agent_id; positions are along the line
+   * */
+  template <class Func>
+  void scan_line(uint64_t code, int length, int agent_id, Func on_hit) const
+  {
+    int state = 0;
+    for (int k = 0; k < length; k++) {
+      const int cell = (code >> (2 * (k + WINDOW_RADIUS))) & 0x3;
+      state = next[state][cell_symbol(cell, agent_id)];
+      for (uint32_t found = hits[state]; found; found &= found - 1) {
+        on_hit(__builtin_ctz(found), k);
+      }
+    }
+  }
+};
+
+constexpr pattern_automaton_t make_pattern_automaton(const char * const * patterns, int num_patterns)
+{
+  pattern_automaton_t automaton = {};
+  automaton.num_states = 1;
+  automaton.num_patterns = num_patterns;
+  for (int s = 0; s < PATTERN_MAX_STATES; s++) {
+    for (int c = 0; c < PATTERN_SYMBOLS; c++) {
+      automaton.next[s][c] = -1;
+    }
+  }
+
+  /* Trie */
+  for (int id = 0; id < num_patterns; id++) {
+    int state = 0;
+    automaton.lengths[id] = pattern_length(patterns[id]);
+    for (int i = 0; i < automaton.lengths[id]; i++) {
+      const int c = pattern_symbol(patterns[id][i]);
+      if (automaton.next[state][c] < 0) {
+        automaton.next[state][c] = automaton.num_states++;
+      }
+      state = automaton.next[state][c];
+    }
+    automaton.hits[state] |= 1U << id;
+  }
+
+  /* Failure links in BFS order, folded into the transitions */
+  int fail[PATTERN_MAX_STATES] = {};
+  int queue[PATTERN_MAX_STATES] = {};
+  int head = 0, tail = 0;
+  for (int c = 0; c < PATTERN_SYMBOLS; c++) {
+    if (automaton.next[0][c] < 0) {
+      automaton.next[0][c] = 0;
+    } else {
+      fail[automaton.next[0][c]] = 0;
+      queue[tail++] = automaton.next[0][c];
+    }
+  }
+  while (head < tail) {
+    const int state = queue[head++];
+    automaton.hits[state] |= automaton.hits[fail[state]];
+    for (int c = 0; c < PATTERN_SYMBOLS; c++) {
+      const int child = automaton.next[state][c];
+      if (child < 0) {
+        automaton.next[state][c] = automaton.next[fail[state]][c];
+      } else {
+        fail[child] = automaton.next[fail[state]][c];
+        queue[tail++] = child;
+      }
+    }
+  }
+  return automaton;
+}
+
+/*
+ * Pattern table file, written at build time by gen_pattern_tables and
+ * mapped read-only at startup; bump the version on any layout change
+ */
+#define PATTERN_TABLE_VERSION 1
+#ifndef PATTERN_TABLE_FILE
+#define PATTERN_TABLE_FILE "pattern_tables.bin"
+#endif
+#ifdef _RENJU
+#define PATTERN_TABLE_RULE 1
+#else
+#define PATTERN_TABLE_RULE 0
+#endif
+
+/* The AVX2 scan reads the line codes of the dense board */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(_SPARSE_BOARD)
+#define PATTERN_SCAN_AVX2
+#endif
+
+/*
+ * Lookup table of the patterns matching through a cell, generated once
+ * from a pattern automaton.
+ * It is indexed by the line window around the cell (BitBoard::window)
+ * and only describes windows whose center holds a stone of agent_id,
+ * which is how the threat searches probe a cell. A pattern through such
+ * a cell always fits within WINDOW_RADIUS cells of it.
+ * Every entry holds the set of matching patterns and the offset of the
+ * center in the lowest matching pattern, so one load replaces the scan
+ * over patterns and offsets.
+ */
+class PatternTable
+{
+public:
+  /*
+   * @brief map the tables of automaton from the file at path, or generate
+   *        them when there is no path or the file is missing or stale
+   * */
+  explicit PatternTable(const pattern_automaton_t & automaton, const char * path = NULL);
+  ~PatternTable();
+
+  PatternTable(const PatternTable &) = delete;
+  PatternTable & operator =(const PatternTable &) = delete;
+
+  /*
+   * @brief write the tables for a later PatternTable(automaton, path)
+   * */
+  bool save(const char * path) const;
+
+  /*
+   * @brief whether the tables come from a mapped file
+   * */
+  bool is_mapped() const
+  {
+    return m_mapping != NULL;
+  }
+
+  /*
+   * @return bit k set when pattern k matches through the window center
+   * */
+  uint32_t matches(unsigned window, int agent_id) const
+  {
+    return m_entries[agent_id][key(window)] & MATCHES_MASK;
+  }
+
+  /*
+   * @return offset of the window center in the lowest matching pattern
+   * */
+  int first_match_pos(unsigned window, int agent_id) const
+  {
+    return m_entries[agent_id][key(window)] >> POS_SHIFT;
+  }
+
+  /*
+   * @brief lowest pattern in id_mask that agent_id would match by playing
+   *        each empty cell of the box [top, bottom] x [left, right], over
+   *        the 4 directions
+   * @param[Out] best_ids (row - top) * (right - left + 1) + col - left;
+   *             NO_PATTERN for occupied cells and cells without a match
+   * */
+  void scan(const mcts::BitBoard & board, int agent_id, uint32_t id_mask,
+            int top, int left, int bottom, int right, uint8_t * best_ids) const;
+  /*
+   * @brief scan() of both colors in one pass over the windows
+   * @param[Out] best_ids best_ids[agent_id] as above, NULL to skip agent_id
+   * */
+  void scan(const mcts::BitBoard & board, uint32_t id_mask,
+            int top, int left, int bottom, int right, uint8_t * best_ids[2]) const;
+
+  static const uint8_t NO_PATTERN = 0xff;
+
+private:
+  static const int POS_SHIFT = 24;
+  static const uint32_t MATCHES_MASK = (1U << POS_SHIFT) - 1;
+  /* Window without its center cell */
+  static const int KEY_BITS = WINDOW_BITS - 2;
+
+  struct file_header_t
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t rule;
+    uint32_t key_bits;
+    uint32_t entry_size;
+    /* Identifies the automaton, hence the pattern list */
+    uint64_t signature;
+    /* Of the entries that follow the header */
+    uint64_t checksum;
+  };
+
+  /* Tables of both agents, one after the other */
+  const uint32_t * m_entries[2];
+  /* Generated tables, empty when mapped */
+  std::vector<uint32_t> m_storage;
+  void * m_mapping;
+  size_t m_mapping_size;
+  uint64_t m_signature;
+
+  void generate(const pattern_automaton_t & automaton);
+  bool map(const char * path);
+  void fill_header(file_header_t & header) const;
+
+  /*
+   * @brief the cell (i, j) of scan(), stored at best_ids[agent_id][k]
+   * */
+  void scan_cell(const mcts::BitBoard & board, uint32_t id_mask, int i, int j,
+                 int k, uint8_t * best_ids[2]) const;
+  void scan_rows(const mcts::BitBoard & board, uint32_t id_mask,
+                 int top, int left, int bottom, int right, uint8_t * best_ids[2]) const;
+#ifdef PATTERN_SCAN_AVX2
+  void scan_rows_avx2(const mcts::BitBoard & board, uint32_t id_mask,
+                      int top, int left, int bottom, int right, uint8_t * best_ids[2]) const;
+#endif
+
+  static unsigned key(unsigned window)
+  {
+    const unsigned center_shift = 2 * WINDOW_RADIUS;
+    return (window & ((1U << center_shift) - 1)) | ((window >> (center_shift + 2)) << center_shift);
+  }
+};
+
 #endif
@@ -0,0 +1,160 @@
+#include "pattern_stats.h"
+
+#ifdef _PATTERN_STATS
+
+#include <atomic>
+#include <chrono>
+
+#include "fast_tss.h"
+
+namespace mcts
+{
+
+struct pattern_counters_t
+{
+  std::atomic<uint64_t> attempts;
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> wins;
+  std::atomic<uint64_t> roots;
+};
+
+/* Prints the counters when the program exits */
+class PatternStats
+{
+public:
+  pattern_counters_t counters[PATTERN_MAX_PATTERNS];
+  std::atomic<uint64_t> gain_square_tests;
+  std::atomic<uint64_t> gain_square_nanos;
+  std::atomic<uint64_t> root_scans;
+  std::atomic<uint64_t> root_cells;
+  std::atomic<uint64_t> root_gains;
+  std::atomic<uint64_t> root_nanos;
+
+  PatternStats()
+  {
+    reset();
+  }
+
+  ~PatternStats()
+  {
+    dump(stderr);
+  }
+
+  void reset()
+  {
+    for (pattern_counters_t & counter : counters) {
+      counter.attempts = 0;
+      counter.hits = 0;
+      counter.wins = 0;
+      counter.roots = 0;
+    }
+    gain_square_tests = 0;
+    gain_square_nanos = 0;
+    root_scans = 0;
+    root_cells = 0;
+    root_gains = 0;
+    root_nanos = 0;
+  }
+
+  void get(pattern_stats_t & stats) const
+  {
+    for (int id = 0; id < PATTERN_MAX_PATTERNS; id++) {
+      stats.attempts[id] = counters[id].attempts.load();
+      stats.hits[id] = counters[id].hits.load();
+      stats.wins[id] = counters[id].wins.load();
+      stats.roots[id] = counters[id].roots.load();
+    }
+    stats.gain_square_tests = gain_square_tests.load();
+    stats.gain_square_nanos = gain_square_nanos.load();
+    stats.root_scans = root_scans.load();
+    stats.root_cells = root_cells.load();
+    stats.root_gains = root_gains.load();
+    stats.root_nanos = root_nanos.load();
+  }
+
+  void dump(FILE * out) const
+  {
+    pattern_stats_t stats;
+    get(stats);
+    fprintf(out, "%4s %-8s %5s %12s %12s %12s %12s\n", "id", "pattern", "level", "attempts", "hits", "wins", "roots");
+    for (int id = 0; id < g_threat_types_num; id++) {
+      fprintf(out, "%4d %-8s %5d %12llu %12llu %12llu %12llu\n",
+              id, g_threat_types[id], g_threat_pattern_levels[id],
+              (unsigned long long)stats.attempts[id],
+              (unsigned long long)stats.hits[id],
+              (unsigned long long)stats.wins[id],
+              (unsigned long long)stats.roots[id]);
+    }
+    fprintf(out, "gain square tests %llu, %.1f ns each\n",
+            (unsigned long long)stats.gain_square_tests,
+            (stats.gain_square_tests) ? (double)stats.gain_square_nanos / stats.gain_square_tests : 0.0);
+    fprintf(out, "root scans %llu, %llu cells, %llu gain squares, %.1f ns per cell\n",
+            (unsigned long long)stats.root_scans,
+            (unsigned long long)stats.root_cells,
+            (unsigned long long)stats.root_gains,
+            (stats.root_cells) ? (double)stats.root_nanos / stats.root_cells : 0.0);
+  }
+};
+
+static PatternStats g_pattern_stats;
+
+void pattern_stats_attempts(uint32_t id_mask)
+{
+  for (; id_mask; id_mask &= id_mask - 1) {
+    g_pattern_stats.counters[__builtin_ctz(id_mask)].attempts.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void pattern_stats_hit(int id)
+{
+  g_pattern_stats.counters[id].hits.fetch_add(1, std::memory_order_relaxed);
+}
+
+void pattern_stats_win(int id)
+{
+  g_pattern_stats.counters[id].wins.fetch_add(1, std::memory_order_relaxed);
+}
+
+void pattern_stats_root(int id)
+{
+  g_pattern_stats.counters[id].roots.fetch_add(1, std::memory_order_relaxed);
+}
+
+void pattern_stats_gain_square_time(uint64_t nanos)
+{
+  g_pattern_stats.gain_square_tests.fetch_add(1, std::memory_order_relaxed);
+  g_pattern_stats.gain_square_nanos.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+void pattern_stats_root_scan(uint64_t cells, uint64_t gains, uint64_t nanos)
+{
+  g_pattern_stats.root_scans.fetch_add(1, std::memory_order_relaxed);
+  g_pattern_stats.root_cells.fetch_add(cells, std::memory_order_relaxed);
+  g_pattern_stats.root_gains.fetch_add(gains, std::memory_order_relaxed);
+  g_pattern_stats.root_nanos.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+uint64_t pattern_stats_clock()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void pattern_stats_get(pattern_stats_t & stats)
+{
+  g_pattern_stats.get(stats);
+}
+
+void pattern_stats_reset()
+{
+  g_pattern_stats.reset();
+}
+
+void pattern_stats_dump(FILE * out)
+{
+  g_pattern_stats.dump(out);
+}
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef _PATTERN_STATS_H_
+#define _PATTERN_STATS_H_
+
+#include <cstdint>
+#include <cstdio>
+
+#include "pattern.h"
+
+/*
+ * Per pattern counters of the threat space search, built with
+ * PATTERN_STATS=1 (-D_PATTERN_STATS) and printed to stderr at exit.
+ * For each g_threat_types id:
+ *   attempts  gain square tests with the pattern in the level range
+ *   hits      tests the pattern won
+ *   wins      hits whose threat led to a winning sequence
+ *   roots     root cells PatternTable::scan() classified as the pattern
+ * Besides them, the time spent in Tss::is_gain_square() and in the root
+ * classification by PatternTable::scan(), with the cells it looked at
+ * (per color) and the gain squares it found; the times
+ * include the clock reads, so they are an upper bound.
+ * Without the flag the macros expand to nothing and no counter exists.
+ */
+#ifdef _PATTERN_STATS
+
+namespace mcts
+{
+
+struct pattern_stats_t
+{
+  uint64_t attempts[PATTERN_MAX_PATTERNS];
+  uint64_t hits[PATTERN_MAX_PATTERNS];
+  uint64_t wins[PATTERN_MAX_PATTERNS];
+  uint64_t roots[PATTERN_MAX_PATTERNS];
+  uint64_t gain_square_tests;
+  uint64_t gain_square_nanos;
+  uint64_t root_scans;
+  uint64_t root_cells;
+  uint64_t root_gains;
+  uint64_t root_nanos;
+};
+
+/*
+ * @brief count one attempt for every pattern id set in id_mask
+ * */
+void pattern_stats_attempts(uint32_t id_mask);
+void pattern_stats_hit(int id);
+void pattern_stats_win(int id);
+
+/*
+ * @brief count one root cell classified as pattern id
+ * */
+void pattern_stats_root(int id);
+
+/*
+ * @brief count one gain square test, which took nanos
+ * */
+void pattern_stats_gain_square_time(uint64_t nanos);
+
+/*
+ * @brief count one root classification of cells, which found gains
+ *        gain squares and took nanos
+ * */
+void pattern_stats_root_scan(uint64_t cells, uint64_t gains, uint64_t nanos);
+
+/*
+ * @return a monotonic clock in nanoseconds
+ * */
+uint64_t pattern_stats_clock();
+
+void pattern_stats_get(pattern_stats_t & stats);
+void pattern_stats_reset();
+void pattern_stats_dump(FILE * out);
+
+}
+
+#define PATTERN_STATS_ATTEMPTS(id_mask) mcts::pattern_stats_attempts(id_mask)
+#define PATTERN_STATS_HIT(id) mcts::pattern_stats_hit(id)
+#define PATTERN_STATS_WIN(id) mcts::pattern_stats_win(id)
+#define PATTERN_STATS_ROOT(id) mcts::pattern_stats_root(id)
+#define PATTERN_STATS_CLOCK(name) const uint64_t name = mcts::pattern_stats_clock()
+#define PATTERN_STATS_GAIN_SQUARE_TIME(start) \
+  mcts::pattern_stats_gain_square_time(mcts::pattern_stats_clock() - (start))
+#else
+#define PATTERN_STATS_ATTEMPTS(id_mask)
+#define PATTERN_STATS_HIT(id)
+#define PATTERN_STATS_WIN(id)
+#define PATTERN_STATS_ROOT(id)
+#define PATTERN_STATS_CLOCK(name)
+#define PATTERN_STATS_GAIN_SQUARE_TIME(start)
+#endif
+
+#endif
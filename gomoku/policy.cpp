@@ -50,7 +50,7 @@ void expand_threat_to_states(const threat_t & threat, const State & root_state,
 {
   const point_t gain = threat.point;
   State new_state(root_state);
-  new_state.position[gain.i][gain.j] = root_state.agent_id;
+  new_state.set(gain.i, gain.j, root_state.agent_id);
   states.push_back(new_state);
 }
 
@@ -79,7 +79,7 @@ void expand_moves_to_states(const std::vector<move_t> & moves, const State & roo
   int agent_id = root_state.agent_id;
   for (const auto & move : moves) {
     State new_state(root_state);
-    new_state.position[move.first][move.second] = agent_id;
+    new_state.set(move.first, move.second, agent_id);
     states.push_back(new_state);
   }
 }
@@ -94,20 +94,23 @@ void find_critical_winning_seq(
 
   int self_agent_id = opponent_state.agent_id ^ 1;
 
-  std::vector<threat_t> candidate_winning_seq(opponent_winning_seq.size());
   std::pair<int, int> remain_winning_seqs[opponent_winning_seq.size()];
 
+  /* Each defense is tried on one scratch board instead of a copy of the state */
+  TssContext & context = tss_context();
+  BitBoard & board = context.load(opponent_state.board);
+  Tss tss(opponent_state);
+  std::vector<threat_t> new_threats;
+
   for (int i = 0; i < (int) opponent_winning_seq.size(); i++) {
     const threat_t & t = opponent_winning_seq[i];
 
-    State new_state(opponent_state);
-    new_state.position[t.point.i][t.point.j] = self_agent_id;
-
-    Tss tss(new_state);
-    std::vector<threat_t> new_threats;
+    context.make(board.index(t.point.i, t.point.j), self_agent_id);
+    new_threats.clear();
     for (auto & threat : opponent_winning_seq) {
-      tss.find_all_threats_at(threat, new_threats, THREAT_LEVEL_3, THREAT_LEVEL_5, 4);
+      tss.find_all_threats_at(board, threat, new_threats, THREAT_LEVEL_3, THREAT_LEVEL_5, 4);
     }
+    context.unmake();
 
     int remain_winning_seq = 0;
     for (auto & threat : new_threats) {
@@ -116,8 +119,6 @@ void find_critical_winning_seq(
       }
     }
     remain_winning_seqs[i] = std::pair<int, int>(remain_winning_seq, i);
-
-    candidate_winning_seq.push_back(t);
   }
 
   std::sort(remain_winning_seqs, remain_winning_seqs + opponent_winning_seq.size());
@@ -140,7 +141,7 @@ void find_top_winning_seq(const std::vector<threat_t> & winning_seq, std::vector
   for (const threat_t & threat : winning_seq) {
     DEBUG_POLICY("Top seq(%c, %d): [%d, %d, %d: %s/%d]\n", 
       threat.point.i + 'A', threat.point.j, threat.winning, 
-      threat.final_winning, threat.min_winning_depth, threat.match_pattern.c_str(), threat.match_pattern_level);
+      threat.final_winning, threat.min_winning_depth, threat_pattern_name(threat.match_pattern), threat.match_pattern_level);
 
     if (threat.final_winning && threat.match_pattern_level >= top_level) {
       top_winning_seq.push_back(threat);
@@ -155,7 +156,7 @@ void find_top_threats_sorted(const std::vector<threat_t> & threats, std::vector<
   for (const threat_t & threat : threats) {
     DEBUG_POLICY("Top threat(%c, %d): [%d, %d, %d: %s/%d]\n", 
       threat.point.i + 'A', threat.point.j, threat.winning, 
-      threat.final_winning, threat.min_winning_depth, threat.match_pattern.c_str(), threat.match_pattern_level);
+      threat.final_winning, threat.min_winning_depth, threat_pattern_name(threat.match_pattern), threat.match_pattern_level);
 
     if (threat.match_pattern_level >= top_level) {
       top_threats.push_back(threat);
@@ -164,21 +165,87 @@ void find_top_threats_sorted(const std::vector<threat_t> & threats, std::vector<
   }
 }
 
-Policy::Policy(int w, int h):
-  m_random_seq(w * h)
+int find_forks(const State & state, int agent_id, std::vector<move_t> & forks)
+{
+  const BitBoard & board = state.board;
+  const ThreatCache & cache = tss_context().threat_cache(board);
+  int best = FORK_NONE;
+
+  /* A three needs another stone within WINDOW_RADIUS */
+  int top, left, bottom, right;
+  board.bounding_box(WINDOW_RADIUS, top, left, bottom, right);
+  for (int i = top; i <= bottom; i++) {
+    for (int j = left; j <= right; j++) {
+      const int index = board.index(i, j);
+      if (!cache.any(index)) {
+        continue;
+      }
+      const int fork = cache.fork(index, agent_id);
+      if (fork > best) {
+        best = fork;
+        forks.clear();
+      }
+      if (fork == best && fork != FORK_NONE) {
+        forks.push_back(move_t(i, j));
+      }
+    }
+  }
+  return best;
+}
+
+int find_top_threat_level(const State & state, int agent_id)
 {
-  for (int i = 0; i < h; i++) {
-    for (int j = 0; j < w; j++) {
-      int index = i * w + j;
-      m_random_seq[index].first = i;
-      m_random_seq[index].second = j;
+  const BitBoard & board = state.board;
+  const ThreatCache & cache = tss_context().threat_cache(board);
+  int best = 0;
+
+  int top, left, bottom, right;
+  board.bounding_box(WINDOW_RADIUS, top, left, bottom, right);
+  for (int i = top; i <= bottom; i++) {
+    for (int j = left; j <= right; j++) {
+      best = std::max(best, cache.best_level(board.index(i, j), agent_id));
     }
   }
+  return best;
+}
+
+int find_fork_moves(const State & opponent_state, std::vector<move_t> & moves)
+{
+  const int self_id = opponent_state.agent_id ^ (1 << 0);
+  std::vector<move_t> self_forks;
+  std::vector<move_t> opponent_forks;
+  int self_fork = find_forks(opponent_state, self_id, self_forks);
+  const int opponent_fork = find_forks(opponent_state, opponent_state.agent_id, opponent_forks);
+  /*
+   * Any four of the opponent gains the tempo back and refutes a
+   * three-three; a four-three starts with a four, which forces the block
+   */
+  if (self_fork == FORK_THREE_THREE &&
+      find_top_threat_level(opponent_state, opponent_state.agent_id) >= ThreatCache::FOUR_LEVEL) {
+    self_fork = FORK_NONE;
+  }
+  /* Ties go to the side to move */
+  if (self_fork != FORK_NONE && self_fork >= opponent_fork) {
+    LOG_POLICY("Agent %d: attack fork\n", self_id);
+    moves.insert(moves.end(), self_forks.begin(), self_forks.end());
+    return POLICY_SUCCESS;
+  }
+  else if (opponent_fork != FORK_NONE) {
+    LOG_POLICY("Agent %d: defend fork\n", self_id);
+    moves.insert(moves.end(), opponent_forks.begin(), opponent_forks.end());
+    return POLICY_SUCCESS;
+  }
+  return POLICY_FAIL;
+}
+
+Policy::Policy(int w, int h):
+  m_width(w),
+  m_height(h)
+{
+  assert(w <= geometry_t::size && h <= geometry_t::size);
 
   unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
   m_random_gen = std::mt19937(seed);
-
-  reshuffle();
 }
 
 Policy::~Policy()
@@ -188,6 +255,13 @@ Policy::~Policy()
 
 void Policy::reshuffle()
 {
+  if (m_random_seq.empty()) {
+    for (int i = 0; i < m_height; i++) {
+      for (int j = 0; j < m_width; j++) {
+        m_random_seq.push_back(move_t(i, j));
+      }
+    }
+  }
   std::shuffle(m_random_seq.begin(), m_random_seq.end(), m_random_gen);
 }
 
@@ -195,11 +269,15 @@ int Policy::move_random(const State & state, std::vector<move_t> & moves, int ma
 {
   DEBUG_POLICY("Agent %d: random_move\n", state.agent_id);
   int sample = 0;
-  for (auto & move : m_random_seq) {
+  if (m_random_seq.empty()) {
+    reshuffle();
+  }
+  for (int k = 0; k < (int)m_random_seq.size(); k++) {
+    const move_t & move = m_random_seq[k];
     int row = move.first;
     int col = move.second;
 
-    if (state.position[row][col] == EMPTY) {
+    if (state.at(row, col) == EMPTY && !state.is_forbidden(row, col, state.agent_id)) {
       DEBUG_POLICY("\tmove_random = [%d, %d: %d]\n", move.first, move.second, state.agent_id);
       moves.push_back(move);
       sample++;
@@ -220,7 +298,7 @@ int Policy::move_random(const State & state, std::vector<State> & next_states, i
   for (auto & move : next_moves) {
     DEBUG_POLICY("\tmove_random = [%d, %d: %d]\n", move.first, move.second, state.agent_id);
     State new_state(state);
-    new_state.position[move.first][move.second] = state.agent_id;
+    new_state.set(move.first, move.second, state.agent_id);
     next_states.push_back(new_state);
   }
   return res;
@@ -295,6 +373,11 @@ int Policy::move_winning_seq(
     }
   }
 
+  if (res != POLICY_SUCCESS) {
+    /* Double threats too deep for the search */
+    res = find_fork_moves(opponent_state, next_moves);
+  }
+
 #endif
 
   return res;
@@ -319,13 +402,10 @@ int Policy::move_rapid(const State & opponent_state, std::vector<move_t> & next_
   State self_state(opponent_state);
   self_state.agent_id ^= (1 << 0);
 
-  std::vector<threat_t> opponent_threats;
-  Tss opponent_tss(opponent_state);
-  opponent_tss.find_all_threats(opponent_state.position, opponent_threats, THREAT_LEVEL_3, THREAT_LEVEL_5, 1);
-
-  std::vector<threat_t> self_threats;
-  Tss self_tss(self_state);
-  self_tss.find_all_threats(self_state.position, self_threats, THREAT_LEVEL_3, THREAT_LEVEL_5, 1);
+  std::vector<threat_t> threats[2];
+  Tss::find_all_threats_both(opponent_state, threats, THREAT_LEVEL_3, THREAT_LEVEL_5, 1, TSS_PRINCIPAL_LINE);
+  std::vector<threat_t> & opponent_threats = threats[(int)opponent_state.agent_id];
+  std::vector<threat_t> & self_threats = threats[(int)self_state.agent_id];
 
   std::sort(opponent_threats.begin(), opponent_threats.end(), std::greater<threat_t>());
   std::sort(self_threats.begin(), self_threats.end(), std::greater<threat_t>());
@@ -338,6 +418,7 @@ int Policy::move_rapid(const State & opponent_state, std::vector<move_t> & next_
   if (res != POLICY_SUCCESS) {
     res = move_when_no_threats(self_state, next_moves);
   }
+  res = keep_allowed_moves(self_state, res, next_moves);
 
   DEBUG_POLICY("Policy rapid result = %d; # states = %d\n",res, next_moves.size());
   return res;
@@ -395,13 +476,10 @@ int Policy::move_defensive(const State & opponent_state, std::vector<std::pair<i
   State self_state(opponent_state);
   self_state.agent_id ^= (1 << 0);
 
-  std::vector<threat_t> opponent_threats;
-  Tss opponent_tss(opponent_state);
-  opponent_tss.find_all_threats(opponent_state.position, opponent_threats, THREAT_LEVEL_3, THREAT_LEVEL_5, max_depth);
-
-  std::vector<threat_t> self_threats;
-  Tss self_tss(self_state);
-  self_tss.find_all_threats(self_state.position, self_threats, THREAT_LEVEL_3, THREAT_LEVEL_5, max_depth);
+  std::vector<threat_t> threats[2];
+  Tss::find_all_threats_both(opponent_state, threats, THREAT_LEVEL_3, THREAT_LEVEL_5, max_depth, TSS_PRINCIPAL_LINE | TSS_PARALLEL);
+  std::vector<threat_t> & opponent_threats = threats[(int)opponent_state.agent_id];
+  std::vector<threat_t> & self_threats = threats[(int)self_state.agent_id];
 
   std::sort(opponent_threats.begin(), opponent_threats.end(), std::greater<threat_t>());
   std::sort(self_threats.begin(), self_threats.end(), std::greater<threat_t>());
@@ -420,6 +498,7 @@ int Policy::move_defensive(const State & opponent_state, std::vector<std::pair<i
   if (res != POLICY_SUCCESS) {
     res = move_when_no_threats(self_state, next_moves);
   }
+  res = keep_allowed_moves(self_state, res, next_moves);
 
   LOG_POLICY("Policy defensive result = %d\n",res);
   return res;
@@ -444,13 +523,10 @@ int Policy::move_balance(const State & opponent_state, std::vector<std::pair<int
   State self_state(opponent_state);
   self_state.agent_id ^= (1 << 0);
 
-  std::vector<threat_t> opponent_threats;
-  Tss opponent_tss(opponent_state);
-  opponent_tss.find_all_threats(opponent_state.position, opponent_threats, THREAT_LEVEL_3, THREAT_LEVEL_5, max_depth);
-
-  std::vector<threat_t> self_threats;
-  Tss self_tss(self_state);
-  self_tss.find_all_threats(self_state.position, self_threats, THREAT_LEVEL_3, THREAT_LEVEL_5, max_depth);
+  std::vector<threat_t> threats[2];
+  Tss::find_all_threats_both(opponent_state, threats, THREAT_LEVEL_3, THREAT_LEVEL_5, max_depth, TSS_PRINCIPAL_LINE | TSS_PARALLEL);
+  std::vector<threat_t> & opponent_threats = threats[(int)opponent_state.agent_id];
+  std::vector<threat_t> & self_threats = threats[(int)self_state.agent_id];
 
   std::sort(opponent_threats.begin(), opponent_threats.end(), std::greater<threat_t>());
   std::sort(self_threats.begin(), self_threats.end(), std::greater<threat_t>());
@@ -489,6 +565,7 @@ int Policy::move_balance(const State & opponent_state, std::vector<std::pair<int
   if (res != POLICY_SUCCESS) {
     res = move_when_no_threats(self_state, next_moves);
   }
+  res = keep_allowed_moves(self_state, res, next_moves);
 
   LOG_POLICY("Policy balance result = %d\n",res);
   return res;
@@ -528,7 +605,7 @@ int Policy::move_middle(const State & state, std::vector<move_t> & next_moves)
 {
   int mr = state.board_height / 2;
   int mc = state.board_width / 2;
-  if (state.position[mr][mc] == EMPTY) {
+  if (state.at(mr, mc) == EMPTY) {
     DEBUG_POLICY("\tmove middle [%d, %d: %d]\n", mr, mc, state.agent_id);
     next_moves.push_back(move_t(mr, mc));
   }
@@ -537,44 +614,17 @@ int Policy::move_middle(const State & state, std::vector<move_t> & next_moves)
 
 int Policy::move_approach_ex(const State & state, std::vector<State> & next_states, int num_samples)
 {
-  static const int RANDOM_RANGE = 2;
-  int w = state.board_width;
-  int h = state.board_height;
-  unsigned int random_ts = w / 2;
-  int res = POLICY_FAIL;
-  int count = 0;
-
-  for (int i = 0; i < h && count < num_samples; i++) {
-    for (int j = 0; j < w && count < num_samples; j++) {
-      if (state.position[i][j] != EMPTY) {
-        for (int k = 0; k < num_samples; k++) {
-          int sign = (m_random_gen() % w) < random_ts ? -1 : 1;
-          int r = i + sign * (m_random_gen() % RANDOM_RANGE);
-          int c = j + sign * (m_random_gen() % RANDOM_RANGE);
-
-          if (!in_boundary(r, c, w, h)) {
-            continue;
-          }
+  std::vector<move_t> next_moves;
+  int res = move_random_approach(state, next_moves, num_samples);
 
-          if (state.position[r][c] == EMPTY) {
-            State new_state(state);
-            new_state.agent_id ^= (1 << state.agent_id);
-            new_state.position[r][c] = new_state.agent_id;
-            next_states.push_back(new_state);
-            res = POLICY_SUCCESS;
-            count++;
-          }
-        }
-      }
-    }
-  }
+  State self_state(state);
+  self_state.agent_id ^= (1 << 0);
 
   if (res == POLICY_FAIL) {
-    State self_state(state);
-    self_state.agent_id ^= (1 << 0);
     return move_when_no_threats(self_state, next_states);
   }
   else {
+    expand_moves_to_states(next_moves, self_state, next_states);
     return res;
   }
 }
@@ -593,7 +643,7 @@ int Policy::move_approach(const State & state, std::vector<move_t> & next_moves)
 {
   Tss tss(state);
   std::vector<threat_t> threats;
-  tss.find_all_threats(threats, THREAT_LEVEL_2, THREAT_LEVEL_2, 2);
+  tss.find_all_threats(threats, THREAT_LEVEL_2, THREAT_LEVEL_2, 2, TSS_PRINCIPAL_LINE);
 
   expand_threats_to_moves(threats, state, next_moves);
 
@@ -606,25 +656,28 @@ int Policy::move_random_approach(const State & self_state, std::vector<move_t> &
 {
   static const int RANDOM_RANGE = 2;
 
+  const BitBoard & board = self_state.board;
   int w = self_state.board_width;
-  int h = self_state.board_height;
   unsigned int random_ts = w / 2;
   int res = POLICY_FAIL;
   int count = 0;
 
-  for (int i = 0; i < h && count < num_samples; i++) {
-    for (int j = 0; j < w && count < num_samples; j++) {
-      if (self_state.position[i][j] != EMPTY) {
+  /*
+   * Samples stay around the first stones in row order, with repeats;
+   * only the box of the stones is scanned, and the WALL padding ends
+   * the steps off the board
+   * */
+  int top, left, bottom, right;
+  board.bounding_box(0, top, left, bottom, right);
+  for (int i = top; i <= bottom && count < num_samples; i++) {
+    for (int j = left; j <= right && count < num_samples; j++) {
+      if (board.at(i, j) != EMPTY) {
         for (int k = 0; k < num_samples; k++) {
           int sign = (m_random_gen() % w) < random_ts ? -1 : 1;
           int r = i + sign * (m_random_gen() % RANDOM_RANGE);
           int c = j + sign * (m_random_gen() % RANDOM_RANGE);
 
-          if (!in_boundary(r, c, w, h)) {
-            continue;
-          }
-
-          if (self_state.position[r][c] == EMPTY) {
+          if (board.at(r, c) == EMPTY && !self_state.is_forbidden(r, c, self_state.agent_id)) {
             next_moves.push_back(move_t(r, c));
             res = POLICY_SUCCESS;
             count++;
@@ -637,4 +690,23 @@ int Policy::move_random_approach(const State & self_state, std::vector<move_t> &
   return res;
 }
 
+/*
+ * @brief drop the moves the rules forbid to self_state.agent_id, falling
+ *        back to random moves when none is left
+ * */
+int Policy::keep_allowed_moves(const State & self_state, int res, std::vector<move_t> & next_moves)
+{
+#ifdef _RENJU
+  next_moves.erase(
+    std::remove_if(next_moves.begin(), next_moves.end(), [&](const move_t & move) {
+      return self_state.is_forbidden(move.first, move.second, self_state.agent_id);
+    }),
+    next_moves.end());
+  if (next_moves.empty()) {
+    res = move_random(self_state, next_moves);
+  }
+#endif
+  return res;
+}
+
 }
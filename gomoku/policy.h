@@ -36,6 +36,24 @@ void find_critical_winning_seq(
 void find_top_winning_seq(const std::vector<threat_t> & winning_seq, std::vector<threat_t> & top_winning_seq);
 void find_top_threats_sorted(const std::vector<threat_t> & threats, std::vector<threat_t> & top_threats);
 
+/*
+ * @brief strongest FORK_* agent_id can make in state, and the moves making it
+ * */
+int find_forks(const State & state, int agent_id, std::vector<move_t> & forks);
+
+/*
+ * @brief best g_threat_pattern_levels agent_id can match with one move in state
+ * */
+int find_top_threat_level(const State & state, int agent_id);
+
+/*
+ * @brief fork moves for the side to move after opponent_state: its own
+ *        forks, unless the opponent has a stronger fork or a four against
+ *        a three-three, else the forks of the opponent to block
+ * @return POLICY_SUCCESS when there are any
+ * */
+int find_fork_moves(const State & opponent_state, std::vector<move_t> & moves);
+
 void expand_threat_to_states(const threat_t & threat, const State & root_state, std::vector<State> & states);
 void expand_threat_to_moves(const threat_t & threat, std::vector<move_t> & moves);
 void expand_threats_to_states(const std::vector<threat_t> & threats, const State & root_state, std::vector<State> & states);
@@ -59,7 +77,10 @@ public:
   int move_balance(const State & opponent_state, std::vector<std::pair<int, int>> & next_moves, int max_depth=DEFAULT_TSS_MAX_DEPTH);
   int move_approach_ex(const State & state, std::vector<State> & next_states, int num_samples=20);
 private:
-  std::vector<std::pair<int, int>> m_random_seq;
+  /* Every cell in random order, built on the first move_random() */
+  std::vector<move_t> m_random_seq;
+  int m_width;
+  int m_height;
   std::mt19937 m_random_gen;
 
   int move_winning_seq(
@@ -75,6 +96,7 @@ private:
   int move_approach(const State & state, std::vector<State> & next_states);
   int move_approach(const State & state, std::vector<move_t> & next_moves);
   int move_random_approach(const State & self_state, std::vector<move_t> & next_moves, int num_samples=12);
+  int keep_allowed_moves(const State & self_state, int res, std::vector<move_t> & next_moves);
 };
 
 }
@@ -0,0 +1,249 @@
+#include "renju.h"
+#include "fast_tss.h"
+
+namespace mcts
+{
+
+/* Patterns making a four or five, and an open or split three */
+static const uint32_t g_four_ids = (2U << g_threat_levels[THREAT_LEVEL_4][BEGIN]) - 1;
+static const uint32_t g_three_ids = (2U << g_threat_levels[THREAT_LEVEL_3][BEGIN]) - 1;
+
+/*
+ * The board with a few black stones tried on top of it, so the nested
+ * checks never touch the board itself
+ */
+class RenjuView
+{
+public:
+  RenjuView(const BitBoard & board):
+    m_board(board),
+    m_size(0)
+  {
+  }
+
+  char at(int index) const
+  {
+    for (int k = 0; k < m_size; k++) {
+      if (m_stones[k] == index) {
+        return BLACK;
+      }
+    }
+    return m_board.at(index);
+  }
+
+  void push(int index)
+  {
+    assert(m_size < MAX_STONES);
+    m_stones[m_size++] = index;
+  }
+
+  void pop()
+  {
+    m_size--;
+  }
+
+private:
+  /* The move and its completing move at each depth */
+  static const int MAX_STONES = 2 * (RENJU_MAX_DEPTH + 1);
+
+  const BitBoard & m_board;
+  int m_stones[MAX_STONES];
+  int m_size;
+};
+
+static int run_length(const RenjuView & view, int index, int offset)
+{
+  int length = 1;
+  for (int cell = index + offset; view.at(cell) == BLACK; cell += offset) {
+    length++;
+  }
+  for (int cell = index - offset; view.at(cell) == BLACK; cell -= offset) {
+    length++;
+  }
+  return length;
+}
+
+/*
+ * @brief empty cells along offset that complete exactly five with the
+ *        stone at index, as steps from index
+ * */
+static int five_points(RenjuView & view, int index, int offset, int points[2])
+{
+  int num_points = 0;
+  for (int k = -(NUMTOWIN - 1); k <= NUMTOWIN - 1; k++) {
+    const int cell = index + k * offset;
+    if (k == 0 || view.at(cell) != EMPTY) {
+      continue;
+    }
+    const int step = (k > 0) ? offset : -offset;
+    bool joined = true;
+    for (int between = index + step; between != cell && joined; between += step) {
+      joined = view.at(between) == BLACK;
+    }
+    if (!joined) {
+      continue;
+    }
+    view.push(cell);
+    if (run_length(view, cell, offset) == NUMTOWIN && num_points < 2) {
+      points[num_points++] = k;
+    }
+    view.pop();
+  }
+  return num_points;
+}
+
+/* A straight four: two completing cells at both ends of four stones */
+static bool is_straight(int num_points, const int points[2])
+{
+  return num_points == 2 && points[1] - points[0] == NUMTOWIN;
+}
+
+static int check(RenjuView & view, int index, int depth);
+
+/*
+ * @brief whether one more stone turns the line through index into a
+ *        straight four, by a move that is itself allowed
+ * */
+static bool is_live_three(RenjuView & view, int index, int offset, int depth)
+{
+  for (int k = -(NUMTOWIN - 2); k <= NUMTOWIN - 2; k++) {
+    const int cell = index + k * offset;
+    if (k == 0 || view.at(cell) != EMPTY) {
+      continue;
+    }
+    int points[2];
+    view.push(cell);
+    const bool straight = is_straight(five_points(view, index, offset, points), points);
+    view.pop();
+    if (straight && (depth >= RENJU_MAX_DEPTH || check(view, cell, depth + 1) < RENJU_OVERLINE)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static int check(RenjuView & view, int index, int depth)
+{
+  view.push(index);
+
+  bool overline = false;
+  for (int dir = 0; dir < NUM_DIR; dir++) {
+    const int length = run_length(view, index, BitBoard::geometry::offset(dir));
+    if (length == NUMTOWIN) {
+      view.pop();
+      return RENJU_FIVE;
+    }
+    overline |= length > NUMTOWIN;
+  }
+
+  int fours = 0;
+  int threes = 0;
+  for (int dir = 0; dir < NUM_DIR && !overline; dir++) {
+    const int offset = BitBoard::geometry::offset(dir);
+    int points[2];
+    const int num_points = five_points(view, index, offset, points);
+    if (num_points > 0) {
+      /* A straight four is one four, two cells apart on one line are two */
+      fours += is_straight(num_points, points) ? 1 : num_points;
+    } else if (is_live_three(view, index, offset, depth)) {
+      threes++;
+    }
+  }
+  view.pop();
+
+  if (overline) {
+    return RENJU_OVERLINE;
+  } else if (fours >= 2) {
+    return RENJU_DOUBLE_FOUR;
+  } else if (threes >= 2) {
+    return RENJU_DOUBLE_THREE;
+  }
+  return RENJU_LEGAL;
+}
+
+int renju_check(const BitBoard & board, int index)
+{
+  assert(board.at(index) == EMPTY);
+  RenjuView view(board);
+  return check(view, index, 0);
+}
+
+/*
+ * @brief whether black would get threats on two lines or a four at the
+ *        empty cell index, which only forbidden cells have
+ * */
+static bool has_double_threat_or_four(const BitBoard & board, int index)
+{
+  const PatternTable & table = threat_pattern_table();
+  const int row = BitBoard::geometry::row(index);
+  const int col = BitBoard::geometry::col(index);
+
+  int threats = 0;
+  bool four = false;
+  for (int dir = 0; dir < NUM_DIR; dir++) {
+    const uint32_t matches = table.matches(board.window(row, col, dir), BLACK);
+    threats += (matches & g_three_ids) != 0;
+    four |= (matches & g_four_ids) != 0;
+  }
+  return threats >= 2 || four;
+}
+
+bool renju_is_forbidden(const BitBoard & board, int index)
+{
+  return has_double_threat_or_four(board, index) && renju_check(board, index) >= RENJU_OVERLINE;
+}
+
+bool RenjuRule::is_candidate(const BitBoard & board, int index)
+{
+  return board.at(index) == EMPTY && has_double_threat_or_four(board, index);
+}
+
+void RenjuRule::update_candidate(const BitBoard & board, int index)
+{
+  const bool candidate = is_candidate(board, index);
+  for (int k = 0; k < (int)m_candidates.size(); k++) {
+    if (m_candidates[k].index == index) {
+      if (!candidate) {
+        m_candidates[k] = m_candidates.back();
+        m_candidates.pop_back();
+      }
+      return;
+    }
+  }
+  if (candidate) {
+    m_candidates.push_back(candidate_t{index, RENJU_UNKNOWN});
+  }
+}
+
+void RenjuRule::reset(const BitBoard & board)
+{
+  m_candidates.clear();
+
+  int top, left, bottom, right;
+  board.bounding_box(WINDOW_RADIUS, top, left, bottom, right);
+  for (int i = top; i <= bottom; i++) {
+    for (int j = left; j <= right; j++) {
+      update_candidate(board, board.index(i, j));
+    }
+  }
+}
+
+void RenjuRule::update(const BitBoard & board, int index)
+{
+  /* The cells whose windows hold index */
+  for (int dir = 0; dir < NUM_DIR; dir++) {
+    const int offset = BitBoard::geometry::offset(dir);
+    for (int k = -WINDOW_RADIUS; k <= WINDOW_RADIUS; k++) {
+      if (board.at(index + k * offset) != WALL) {
+        update_candidate(board, index + k * offset);
+      }
+    }
+  }
+
+  /* A three far from the move can depend on it through a nested check */
+  for (candidate_t & candidate : m_candidates) {
+    candidate.status = RENJU_UNKNOWN;
+  }
+}
+
+}
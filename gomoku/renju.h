@@ -0,0 +1,91 @@
+#ifndef _RENJU_H_
+#define _RENJU_H_
+
+#include <vector>
+
+#include "bitboard.h"
+#include "constants.h"
+
+/* Outcome of a black move under the Renju rules */
+#define RENJU_LEGAL 0
+#define RENJU_FIVE 1
+#define RENJU_OVERLINE 2
+#define RENJU_DOUBLE_FOUR 3
+#define RENJU_DOUBLE_THREE 4
+/* Not checked since the last change of the board */
+#define RENJU_UNKNOWN -1
+
+/*
+ * A three only counts when the move turning it into a straight four is
+ * itself allowed; that check nests at most this deep, deeper moves are
+ * taken as allowed
+ */
+#define RENJU_MAX_DEPTH 3
+
+namespace mcts
+{
+
+/*
+ * @brief RENJU_* of a black stone on the empty cell index
+ *        exactly five wins even when it also makes a double four
+ * */
+int renju_check(const BitBoard & board, int index);
+
+/*
+ * @brief whether black may not play on the empty cell index
+ *        cells with no double threat and no four are ruled out by a
+ *        window lookup before the full check
+ * */
+bool renju_is_forbidden(const BitBoard & board, int index);
+
+/*
+ * Forbidden cells of black on a board, kept in step with the board.
+ * Only cells where black would get threats on two lines or a four can be
+ * forbidden; those candidates are tracked through the windows a move
+ * changes, everything else is allowed without a look. A move may change any
+ * candidate through the nested checks, so it only marks them unknown;
+ * each is checked again the first time it is asked about.
+ */
+class RenjuRule
+{
+public:
+  void reset(const BitBoard & board);
+
+  /*
+   * @brief after board.set() at index
+   * */
+  void update(const BitBoard & board, int index);
+
+  /*
+   * @brief whether black may not play at index on board, the board the
+   *        rule was updated with
+   * */
+  bool is_forbidden(const BitBoard & board, int index) const
+  {
+    for (const candidate_t & candidate : m_candidates) {
+      if (candidate.index == index) {
+        if (candidate.status == RENJU_UNKNOWN) {
+          candidate.status = renju_check(board, index);
+        }
+        return candidate.status >= RENJU_OVERLINE;
+      }
+    }
+    return false;
+  }
+
+private:
+  struct candidate_t
+  {
+    int index;
+    mutable int status;
+  };
+
+  std::vector<candidate_t> m_candidates;
+
+  static bool is_candidate(const BitBoard & board, int index);
+  void update_candidate(const BitBoard & board, int index);
+};
+
+}
+
+#endif
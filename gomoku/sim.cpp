@@ -7,14 +7,19 @@ namespace mcts
 
 int sim_check_win(const State & state)
 {
-  return util_check_win(state.position, state.board_width, state.board_height);
+  if (state.has_last_move()) {
+    return util_check_win_at(state.board, state.last_move.first, state.last_move.second);
+  }
+  return util_check_win(state.board);
 }
 
-int sim_check_win(const Position & position, board_t & board, int agent_id, int row, int col, int w, int h)
+int sim_check_win(const Position & position, int row, int col)
 {
-  int connectivity = update_connectivity_at(board, position, row, col, w, h);
-
-  return connectivity >= NUMTOWIN ? agent_id : NOT_END;
+  const int height = position.size();
+  const int width = position.empty() ? 0 : position[0].size();
+  State state(height, width, position, EMPTY);
+  return (row >= 0) ? util_check_win_at(state.board, row, col) :
+                      util_check_win(state.board);
 }
 
 const move_t sim_single_iteration_random(Policy & policy, const State & state, int max_random_moves, std::mt19937 & random_gen)
@@ -33,8 +38,7 @@ const move_t sim_single_iteration_random(Policy & policy, const State & state, S
   const move_t next_move = sim_single_iteration_random(policy, state, max_random_moves, random_gen);
   if (is_valid_move(next_move)) {
     next_state = state;
-    next_state.agent_id ^= (1 << 0);
-    next_state.position[next_move.first][next_move.second] = next_state.agent_id;
+    next_state.play(next_move);
   }
   return next_move;
 }
@@ -49,46 +53,32 @@ int sim_rapid_until_end(Policy & policy, const State & state, int max_iter, int
 {
   assert(state.board_width * state.board_height >= max_random_moves);
 
-  const static int BLACK_ID = (int) BLACK;
-  const static int WHITE_ID = (int) WHITE;
-
   unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
   std::mt19937 random_gen(seed);
 
-  const int w = state.board_width;
-  const int h = state.board_height;
-
-  State last_state(state);
-  State next_state(state);
-
-  board_t boards[2] = {
-    board_t(state.board_height, std::vector<board_node_t>(state.board_width)),
-    board_t(state.board_height, std::vector<board_node_t>(state.board_width))
-  };
-  find_connectivities(boards[BLACK_ID], state.position, BLACK);
-  find_connectivities(boards[WHITE_ID], state.position, WHITE);
+  /* The playout runs on one board, moves are played in place */
+  State sim_state(state);
 
   int res = NOT_END;
   for (int iter = 0; iter < max_iter; iter++) {
-    const move_t next_move = sim_single_iteration_random(policy, last_state, next_state, max_random_moves, random_gen);
-
-    DEBUG_SIM("Iter = %d; Agent = %d; Move = (%d, %d)\n", iter, next_state.agent_id, next_move.first, next_move.second);
-    DEBUG_SIM_STATE(next_state);
+    const move_t next_move = sim_single_iteration_random(policy, sim_state, max_random_moves, random_gen);
 
     if (!is_valid_move(next_move)) {
       res = EMPTY;
       break;
     }
 
-    int next_state_agent_id = (int)next_state.agent_id;
-    res = sim_check_win(last_state.position, boards[next_state_agent_id], next_state_agent_id, next_move.first, next_move.second, w, h);
+    sim_state.play(next_move);
+
+    DEBUG_SIM("Iter = %d; Agent = %d; Move = (%d, %d)\n", iter, sim_state.agent_id, next_move.first, next_move.second);
+    DEBUG_SIM_STATE(sim_state);
 
-    DEBUG_SIM("Check winning status %d\n", next_state_agent_id);
+    res = util_check_win_at(sim_state.board, next_move.first, next_move.second);
+
+    DEBUG_SIM("Check winning status %d\n", sim_state.agent_id);
     if (res == BLACK || res == WHITE) {
       break;
     }
-
-    last_state = next_state;
   }
   return res;
 }
@@ -21,9 +21,17 @@ class Policy;
 
 const static move_t INVALID_MOVE(INVALID, INVALID);
 
+/*
+ * @brief winning status of state; only the lines through its last move
+ *        are checked when it is known
+ * */
 int sim_check_win(const State & state);
 
-int sim_check_win(const Position & position, board_t & board, int agent_id, int row, int col, int w, int h);
+/*
+ * @brief winning status of position; (row, col) is the stone just placed,
+ *        which limits the check to the lines through it
+ * */
+int sim_check_win(const Position & position, int row = -1, int col = -1);
 
 const move_t sim_single_iteration_random(Policy & policy, const State & state, int max_random_moves, std::mt19937 & random_gen);
 
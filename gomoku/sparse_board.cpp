@@ -0,0 +1,60 @@
+#include "sparse_board.h"
+#include "util.h"
+
+namespace mcts
+{
+
+template <class Geometry>
+void BasicSparseBoard<Geometry>::clear()
+{
+  m_hash = 0;
+  m_count[(int)BLACK] = m_count[(int)WHITE] = 0;
+  m_top = m_left = m_bottom = m_right = 0;
+  m_stones.clear();
+}
+
+template <class Geometry>
+void BasicSparseBoard<Geometry>::update_box()
+{
+  bool first = true;
+  m_stones.for_each([&](int index, char) {
+    const int row = Geometry::row(index);
+    const int col = Geometry::col(index);
+    if (first) {
+      m_top = m_bottom = row;
+      m_left = m_right = col;
+      first = false;
+    } else {
+      m_top = std::min(m_top, row);
+      m_bottom = std::max(m_bottom, row);
+      m_left = std::min(m_left, col);
+      m_right = std::max(m_right, col);
+    }
+  });
+}
+
+template <class Geometry>
+void BasicSparseBoard<Geometry>::load(const Position & position)
+{
+  clear();
+  for (int i = 0; i < m_height; i++) {
+    for (int j = 0; j < m_width; j++) {
+      if (position[i][j] != EMPTY) {
+        set(i, j, position[i][j]);
+      }
+    }
+  }
+}
+
+template <class Geometry>
+void BasicSparseBoard<Geometry>::store(Position & position) const
+{
+  position = Position(m_height, std::vector<char>(m_width, EMPTY));
+  m_stones.for_each([&](int index, char agent_id) {
+    position[Geometry::row(index)][Geometry::col(index)] = agent_id;
+  });
+}
+
+template class BasicSparseBoard<geometry_t>;
+
+}
@@ -0,0 +1,344 @@
+#ifndef _SPARSE_BOARD_H_
+#define _SPARSE_BOARD_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "bitboard.h"
+#include "constants.h"
+
+namespace mcts
+{
+
+/*
+ * Open-addressed map from cell index to Value, linear probing with
+ * backward-shift deletion (no tombstones).
+ * Memory and the cost of every operation grow with the number of
+ * entries, not with the board area.
+ */
+template <class Value>
+class SparseCellMap
+{
+public:
+  SparseCellMap():
+    m_entries(1 << MIN_BITS),
+    m_size(0),
+    m_shift(32 - MIN_BITS)
+  {
+  }
+
+  int size() const
+  {
+    return m_size;
+  }
+
+  const Value * find(int index) const
+  {
+    for (int slot = home(index); m_entries[slot].index != FREE; slot = next(slot)) {
+      if (m_entries[slot].index == index) {
+        return &m_entries[slot].value;
+      }
+    }
+    return NULL;
+  }
+
+  Value * find(int index)
+  {
+    return const_cast<Value *>(static_cast<const SparseCellMap &>(*this).find(index));
+  }
+
+  /*
+   * @brief value at index, inserted as Value() when missing
+   * */
+  Value & operator[](int index)
+  {
+    if (2 * (m_size + 1) > (int)m_entries.size()) {
+      grow();
+    }
+    int slot = home(index);
+    for (; m_entries[slot].index != FREE; slot = next(slot)) {
+      if (m_entries[slot].index == index) {
+        return m_entries[slot].value;
+      }
+    }
+    m_entries[slot].index = index;
+    m_entries[slot].value = Value();
+    m_size++;
+    return m_entries[slot].value;
+  }
+
+  void erase(int index)
+  {
+    int slot = home(index);
+    for (; m_entries[slot].index != index; slot = next(slot)) {
+      if (m_entries[slot].index == FREE) {
+        return;
+      }
+    }
+    /* Shift back the entries of the run that probed past the hole */
+    int hole = slot;
+    for (slot = next(slot); m_entries[slot].index != FREE; slot = next(slot)) {
+      const int want = home(m_entries[slot].index);
+      if (((slot - want) & mask()) >= ((slot - hole) & mask())) {
+        m_entries[hole] = m_entries[slot];
+        hole = slot;
+      }
+    }
+    m_entries[hole].index = FREE;
+    m_size--;
+  }
+
+  void clear()
+  {
+    for (auto & entry : m_entries) {
+      entry.index = FREE;
+    }
+    m_size = 0;
+  }
+
+  template <class Func>
+  void for_each(Func func) const
+  {
+    for (const auto & entry : m_entries) {
+      if (entry.index != FREE) {
+        func(entry.index, entry.value);
+      }
+    }
+  }
+
+private:
+  static const int FREE = -1;
+  static const int MIN_BITS = 4;
+
+  struct entry_t
+  {
+    int index = FREE;
+    Value value;
+  };
+
+  std::vector<entry_t> m_entries;
+  int m_size;
+  /* 32 - log2(capacity), for Fibonacci hashing */
+  int m_shift;
+
+  int mask() const
+  {
+    return (int)m_entries.size() - 1;
+  }
+
+  int home(int index) const
+  {
+    return (int)(((uint32_t)index * 0x9e3779b1U) >> m_shift);
+  }
+
+  int next(int slot) const
+  {
+    return (slot + 1) & mask();
+  }
+
+  void grow()
+  {
+    std::vector<entry_t> entries(2 * m_entries.size());
+    entries.swap(m_entries);
+    m_size = 0;
+    m_shift--;
+    for (const auto & entry : entries) {
+      if (entry.index != FREE) {
+        (*this)[entry.index] = entry.value;
+      }
+    }
+  }
+};
+
+/*
+ * Sparse board with the interface of BasicBitBoard.
+ * Only the stones and the counters of the cells around them are stored,
+ * so a move costs the same on a 15x15 and on a 4096x4096 board, and the
+ * size of a board is bounded only by the index range of Geometry.
+ * Cells are addressed with the same flat indices as the dense board, so
+ * direction walks by Geometry::offset() work unchanged; cells off the
+ * board read as WALL.
+ * Built with _SPARSE_BOARD, BitBoard names this class.
+ */
+template <class Geometry>
+class BasicSparseBoard
+{
+public:
+  typedef Geometry geometry;
+
+  BasicSparseBoard(int height, int width):
+    m_height(height),
+    m_width(width)
+  {
+    assert(height <= Geometry::size && width <= Geometry::size);
+    clear();
+  }
+
+  int height() const
+  {
+    return m_height;
+  }
+
+  int width() const
+  {
+    return m_width;
+  }
+
+  static int index(int row, int col)
+  {
+    return Geometry::index(row, col);
+  }
+
+  /*
+   * @return BLACK, WHITE, EMPTY or WALL (outside the board)
+   * */
+  char at(int row, int col) const
+  {
+    if (row < 0 || row >= m_height || col < 0 || col >= m_width) {
+      return WALL;
+    }
+    const char * stone = m_stones.find(Geometry::index(row, col));
+    return (stone) ? *stone : EMPTY;
+  }
+
+  char at(int index) const
+  {
+    return at(Geometry::row(index), Geometry::col(index));
+  }
+
+  bool is_empty(int row, int col) const
+  {
+    return at(row, col) == EMPTY;
+  }
+
+  /*
+   * @brief place a stone of agent_id, or clear the cell with EMPTY
+   * */
+  void set(int row, int col, char agent_id)
+  {
+    set(Geometry::index(row, col), agent_id);
+  }
+
+  void set(int index, char agent_id)
+  {
+    const char old_agent_id = at(index);
+    assert(old_agent_id != WALL);
+    if (old_agent_id != EMPTY) {
+      m_stones.erase(index);
+      m_hash ^= zobrist_key(old_agent_id, index);
+      m_count[(int)old_agent_id]--;
+    }
+    if (agent_id != EMPTY) {
+      assert(agent_id == BLACK || agent_id == WHITE);
+      m_stones[index] = agent_id;
+      m_hash ^= zobrist_key(agent_id, index);
+      m_count[(int)agent_id]++;
+    }
+    update_extent(index, old_agent_id, agent_id);
+  }
+
+  /*
+   * @brief WINDOW_CELLS cells centered on (row, col) along BOARD_DIRS[dir]
+   *        cell k of the window is window_cell(window, k); cells off the
+   *        board read as WALL
+   * */
+  unsigned window(int row, int col, int dir) const
+  {
+    const int offset = Geometry::offset(dir);
+    const int center = Geometry::index(row, col);
+    unsigned window = 0;
+    for (int k = 0; k < WINDOW_CELLS; k++) {
+      window |= (unsigned)at(center + (k - WINDOW_RADIUS) * offset) << (2 * k);
+    }
+    return window;
+  }
+
+  /*
+   * @brief Zobrist key of the stones on the board, updated by set()
+   * */
+  uint64_t hash() const
+  {
+    return m_hash;
+  }
+
+  int count(char agent_id) const
+  {
+    return m_count[(int)agent_id];
+  }
+
+  int stone_count() const
+  {
+    return m_count[(int)BLACK] + m_count[(int)WHITE];
+  }
+
+  bool is_full() const
+  {
+    return stone_count() == m_height * m_width;
+  }
+
+  /*
+   * @brief bounding box of the stones grown by margin cells on each side
+   *        and clipped to the board; top > bottom on an empty board
+   * */
+  void bounding_box(int margin, int & top, int & left, int & bottom, int & right) const
+  {
+    if (stone_count() == 0) {
+      top = left = 0;
+      bottom = right = -1;
+      return;
+    }
+    top = std::max(m_top - margin, 0);
+    left = std::max(m_left - margin, 0);
+    bottom = std::min(m_bottom + margin, m_height - 1);
+    right = std::min(m_right + margin, m_width - 1);
+  }
+
+  void load(const Position & position);
+  void store(Position & position) const;
+
+private:
+  int m_height;
+  int m_width;
+  uint64_t m_hash;
+  int m_count[2];
+  /* Bounding box of the stones, valid when there are any */
+  int m_top, m_left, m_bottom, m_right;
+  SparseCellMap<char> m_stones;
+
+  void clear();
+  void update_box();
+
+  static bool is_stone(char value)
+  {
+    return value == BLACK || value == WHITE;
+  }
+
+  void update_extent(int index, char old_value, char value)
+  {
+    const int row = Geometry::row(index);
+    const int col = Geometry::col(index);
+    if (is_stone(value) && !is_stone(old_value)) {
+      if (stone_count() == 1) {
+        m_top = m_bottom = row;
+        m_left = m_right = col;
+      } else {
+        m_top = std::min(m_top, row);
+        m_bottom = std::max(m_bottom, row);
+        m_left = std::min(m_left, col);
+        m_right = std::max(m_right, col);
+      }
+    } else if (!is_stone(value) && is_stone(old_value)) {
+      if (row == m_top || row == m_bottom || col == m_left || col == m_right) {
+        update_box();
+      }
+    }
+  }
+};
+
+typedef BasicSparseBoard<geometry_t> SparseBoard;
+
+}
+
+#endif
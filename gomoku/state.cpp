@@ -8,25 +8,36 @@ namespace mcts
 State::State(int board_height, int board_width, char agent_id):
   board_height(board_height),
   board_width(board_width),
-  agent_id(agent_id)
+  board(board_height, board_width),
+  agent_id(agent_id),
+  last_move(-1, -1)
 {
-  position = Position(board_height, Row(board_width, EMPTY));
 }
 
 State::State(int board_height, int board_width, const Position& position,
              char agent_id):
   board_height(board_height),
   board_width(board_width),
-  position(position),
-  agent_id(agent_id)
+  board(board_height, board_width),
+  agent_id(agent_id),
+  last_move(-1, -1)
 {
+  board.load(position);
+#ifdef _RENJU
+  renju.reset(board);
+#endif
 }
 
 State::State(const State& other):
   board_height(other.board_height),
   board_width(other.board_width),
-  position(other.position),
-  agent_id(other.agent_id)
+  board(other.board),
+  agent_id(other.agent_id),
+  last_move(other.last_move),
+#ifdef _RENJU
+  renju(other.renju),
+#endif
+  m_history(other.m_history)
 {
 }
 
@@ -61,11 +72,14 @@ void State::simulate(std::vector<double> &payoffs) const
   }
 }
 
+void State::get_position(Position& position) const
+{
+  board.store(position);
+}
+
 std::ostream& operator<<(std::ostream &strm, const State& obj)
 {
-  const auto& position = obj.position;
-  print_position(strm, position);
-  return strm;
+  return strm << obj.board;
 }
 
 }
@@ -1,8 +1,12 @@
 #ifndef STATE_H_INCLUDED
 #define STATE_H_INCLUDED
 
+#include <vector>
+
+#include "bitboard.h"
 #include "constants.h"
 #include "policy.h"
+#include "renju.h"
 #include "sim.h"
 #include "util.h"
 
@@ -17,19 +21,130 @@ class State
 public:
   int board_height;
   int board_width;
-  Position position;
+  BitBoard board;
   char agent_id;
+  /* Last stone placed through set() or play(), (-1, -1) when unknown */
+  move_t last_move;
+#ifdef _RENJU
+  /* Forbidden cells of black, kept in step by set(), play() and undo() */
+  RenjuRule renju;
+#endif
 
   State(int board_height, int board_width, char agent_id);
   State(int board_height, int board_width, const Position& position,
         char agent_id);
   State(const State& other);
 
+  char at(int row, int col) const
+  {
+    return board.at(row, col);
+  }
+
+  /*
+   * @brief place a stone, recorded as the last move, or clear a cell
+   * */
+  void set(int row, int col, char stone)
+  {
+    board.set(row, col, stone);
+    update_derived(board.index(row, col));
+    last_move = (stone != EMPTY) ? move_t(row, col) : move_t(-1, -1);
+  }
+
+  bool has_last_move() const
+  {
+    return last_move.first >= 0;
+  }
+
+  /*
+   * @brief switch sides and place a stone of the new agent_id at move,
+   *        the same step the policies take when they expand a state
+   * */
+  void play(const move_t & move)
+  {
+    const int index = board.index(move.first, move.second);
+    history_t entry;
+    entry.index = index;
+    entry.last_index = has_last_move() ?
+      board.index(last_move.first, last_move.second) : NO_INDEX;
+    m_history.push_back(entry);
+    agent_id ^= (1 << 0);
+    board.set(index, agent_id);
+    update_derived(index);
+    last_move = move;
+  }
+
+  /*
+   * @brief take back the last play(); the board restores its hash
+   *        and line codes as the stone is removed
+   * */
+  void undo()
+  {
+    assert(!m_history.empty());
+    const history_t entry = m_history.back();
+    m_history.pop_back();
+    board.set(entry.index, EMPTY);
+    update_derived(entry.index);
+    agent_id ^= (1 << 0);
+    last_move = (entry.last_index != NO_INDEX) ?
+      move_t(geometry_t::row(entry.last_index), geometry_t::col(entry.last_index)) :
+      move_t(-1, -1);
+  }
+
+  int history_size() const
+  {
+    return (int)m_history.size();
+  }
+
+  /*
+   * @brief whether agent_id may not play at (row, col): the forbidden
+   *        moves of black under the Renju rules, built with _RENJU
+   * */
+  bool is_forbidden(int row, int col, char agent_id) const
+  {
+#ifdef _RENJU
+    return agent_id == BLACK && renju.is_forbidden(board, board.index(row, col));
+#else
+    return false;
+#endif
+  }
+
+  /*
+   * @brief Zobrist key of the position, with the side to move folded in
+   * */
+  uint64_t hash() const
+  {
+    return board.hash() ^ ((agent_id == WHITE) ? zobrist_side_key() : 0);
+  }
+
+  void get_position(Position& position) const;
+
   void get_expanded_states(std::vector<State> &expanded_states,
                            int strategy) const;
   void simulate(std::vector<double> &payoffs) const;
 
   friend std::ostream& operator<<(std::ostream &strm, const State& obj);
+
+private:
+  static const int NO_INDEX = -1;
+
+  struct history_t
+  {
+    int index;
+    int last_index;
+  };
+
+  /* Empty outside of play(), so copying a state does not allocate */
+  std::vector<history_t> m_history;
+
+  /*
+   * @brief refresh what is derived from the board after a change at index
+   * */
+  void update_derived(int index)
+  {
+#ifdef _RENJU
+    renju.update(board, index);
+#endif
+  }
 };
 
 }
@@ -38,4 +38,26 @@ TEST_CASE("mcts", "[mcts]")
     REQUIRE(root_node->is_fully_expanded() == true);
     REQUIRE(root_node->is_game_finished() == false);
   }
+
+  SECTION("Should open children as the simulations grow") {
+    State state(15, 15, BLACK);
+    state.set(7, 7, BLACK);
+    state.set(7, 8, WHITE);
+    state.set(8, 7, BLACK);
+    state.set(6, 8, WHITE);
+    TreeNode node(state);
+    std::vector<double> payoffs {0.0, 0.0};
+    int open = 0;
+    for (int sim_count : { 0, 1, 7, 8, 100, 1000 }) {
+      while (node.get_simulation_count() < sim_count) {
+        node.update(payoffs);
+      }
+      while (node.expand() != NULL) {
+        open++;
+      }
+      REQUIRE(open == (int)node.max_open_children());
+      REQUIRE(node.is_fully_expanded() == true);
+    }
+    REQUIRE(open == 1 + (int)pow(1000, kWideningExponent));
+  }
 }
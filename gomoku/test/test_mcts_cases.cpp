@@ -543,7 +543,9 @@ void validate(const char& turn, const StrPosition& str_board,
   State result_state(height, width, EMPTY);
   mcts.run(root_state, result_state);
   point_t point;
-  find_position_diff(pos_board, result_state.position, point);
+  Position pos_result;
+  result_state.get_position(pos_result);
+  find_position_diff(pos_board, pos_result, point);
   if (pos_expected[point.j][point.i] != turn) {
     std::cerr << "AI placed (" << point.j << ", " << point.i << ")" << '\n';
   }
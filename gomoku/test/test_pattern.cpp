@@ -0,0 +1,498 @@
+#include "test_base.h"
+
+#include <atomic>
+#include <random>
+#include <vector>
+
+#include "../fast_tss.h"
+
+using namespace mcts;
+
+TEST_CASE("pattern table", "[pattern]")
+{
+  const PatternTable table(g_threat_automaton);
+  std::mt19937 random_gen(2017);
+
+  /* Random boards; every own stone is probed in every direction */
+  for (int round = 0; round < 20; round++) {
+    BitBoard board(15, 15);
+    for (int k = 0; k < 80; k++) {
+      const int row = random_gen() % 15;
+      const int col = random_gen() % 15;
+      board.set(row, col, (char)(random_gen() % 3));
+    }
+
+    for (int row = 0; row < 15; row++) {
+      for (int col = 0; col < 15; col++) {
+        const int agent_id = board.at(row, col);
+        if (agent_id == EMPTY) {
+          continue;
+        }
+        for (int dir = 0; dir < NUM_DIR; dir++) {
+          const unsigned window = board.window(row, col, dir);
+          const uint32_t matches = table.matches(window, agent_id);
+          int first_id = -1;
+          for (int id = 0; id < g_threat_types_num; id++) {
+            const int pos = match_pattern(board, row, col, dir,
+                                          g_threat_types[id], g_threat_types_len[id], agent_id);
+            REQUIRE(((matches >> id) & 1) == (pos != MISMATCH));
+            if (pos != MISMATCH && first_id < 0) {
+              first_id = id;
+              REQUIRE(table.first_match_pos(window, agent_id) == pos);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("pattern scan", "[pattern]")
+{
+  const PatternTable table(g_threat_automaton);
+  std::mt19937 random_gen(2018);
+
+  for (int round = 0; round < 20; round++) {
+    BitBoard board(15, 15);
+    for (int k = 0; k < 60; k++) {
+      board.set(random_gen() % 15, random_gen() % 15, (char)(random_gen() % 3));
+    }
+    const int agent_id = round % 2;
+    const uint32_t id_mask = (round % 3) ? 0x7ff : 0x7800;
+    const int top = random_gen() % 5, left = random_gen() % 5;
+    const int bottom = 14 - random_gen() % 5, right = 14 - random_gen() % 5;
+    const int box_width = right - left + 1;
+    std::vector<uint8_t> best_ids((bottom - top + 1) * box_width);
+    table.scan(board, agent_id, id_mask, top, left, bottom, right, best_ids.data());
+
+    for (int i = top; i <= bottom; i++) {
+      for (int j = left; j <= right; j++) {
+        int expected = PatternTable::NO_PATTERN;
+        if (board.at(i, j) == EMPTY) {
+          board.set(i, j, agent_id);
+          for (int dir = 0; dir < NUM_DIR; dir++) {
+            const uint32_t matches = table.matches(board.window(i, j, dir), agent_id) & id_mask;
+            for (int id = 0; id < g_threat_types_num; id++) {
+              if (((matches >> id) & 1) && id < expected) {
+                expected = id;
+              }
+            }
+          }
+          board.set(i, j, EMPTY);
+        }
+        REQUIRE((int)best_ids[(i - top) * box_width + j - left] == expected);
+      }
+    }
+
+    /* Both colors in one scan match a scan of each */
+    std::vector<uint8_t> opponent_ids(best_ids.size());
+    table.scan(board, agent_id ^ 1, id_mask, top, left, bottom, right, opponent_ids.data());
+    std::vector<uint8_t> both_ids[2] = { std::vector<uint8_t>(best_ids.size()), std::vector<uint8_t>(best_ids.size()) };
+    uint8_t * both[2] = { both_ids[0].data(), both_ids[1].data() };
+    table.scan(board, id_mask, top, left, bottom, right, both);
+    REQUIRE(both_ids[agent_id] == best_ids);
+    REQUIRE(both_ids[agent_id ^ 1] == opponent_ids);
+  }
+}
+
+TEST_CASE("pattern automaton line scan", "[pattern]")
+{
+  std::mt19937 random_gen(2019);
+
+  for (int round = 0; round < 20; round++) {
+    BitBoard board(15, 15);
+    for (int k = 0; k < 100; k++) {
+      board.set(random_gen() % 15, random_gen() % 15, (char)(random_gen() % 3));
+    }
+    const int agent_id = round % 2;
+
+    /* Every row scanned at once against every pattern at every column */
+    for (int row = 0; row < 15; row++) {
+      int symbols[15];
+      for (int col = 0; col < 15; col++) {
+        symbols[col] = cell_symbol(board.at(row, col), agent_id);
+      }
+      std::vector<uint32_t> hits(15, 0);
+      g_threat_automaton.scan(symbols, 15, [&](int id, int end) {
+        const int begin = end - g_threat_types_len[id] + 1;
+        REQUIRE(begin >= 0);
+        hits[begin] |= 1U << id;
+      });
+
+#ifndef _SPARSE_BOARD
+      std::vector<uint32_t> line_hits(15, 0);
+      const uint64_t code = board.line_codes(1)[BitBoard::geometry::line(1, row, 0)];
+      g_threat_automaton.scan_line(code, 15, agent_id, [&](int id, int end) {
+        line_hits[end - g_threat_types_len[id] + 1] |= 1U << id;
+      });
+      REQUIRE(line_hits == hits);
+#endif
+
+      for (int col = 0; col < 15; col++) {
+        uint32_t expected = 0;
+        for (int id = 0; id < g_threat_types_num; id++) {
+          const int len = g_threat_types_len[id];
+          bool match = col + len <= 15;
+          for (int i = 0; match && i < len; i++) {
+            match = match_pattern_position(g_threat_types[id][i], board.at(row, col + i), agent_id);
+          }
+          expected |= (uint32_t)match << id;
+        }
+        REQUIRE(hits[col] == expected);
+      }
+    }
+  }
+}
+
+/*
+ * @brief up to stones random stones around the center, the side to move
+ *        taken from the parity of seed
+ * */
+static State random_position(unsigned seed, int stones)
+{
+  std::mt19937 random_gen(seed);
+  State state(15, 15, seed % 2);
+  for (int k = 0; k < stones; k++) {
+    const int row = 3 + random_gen() % 9;
+    const int col = 3 + random_gen() % 9;
+    state.set(row, col, (char)(random_gen() % 2));
+  }
+  return state;
+}
+
+static void require_same_threats(const std::vector<threat_t> & threats, const std::vector<threat_t> & expected)
+{
+  REQUIRE(threats.size() == expected.size());
+  for (int k = 0; k < (int)expected.size(); k++) {
+    REQUIRE(threats[k].point.i == expected[k].point.i);
+    REQUIRE(threats[k].point.j == expected[k].point.j);
+    REQUIRE(threats[k].match_pattern_level == expected[k].match_pattern_level);
+    REQUIRE(threats[k].final_winning == expected[k].final_winning);
+    REQUIRE(threats[k].min_winning_depth == expected[k].min_winning_depth);
+  }
+}
+
+TEST_CASE("threats of both colors", "[pattern]")
+{
+  for (int round = 0; round < 10; round++) {
+    const State state = random_position(202100 + round, 30);
+
+    std::vector<threat_t> threats[2];
+    Tss::find_all_threats_both(state, threats, THREAT_LEVEL_3, THREAT_LEVEL_5, 4);
+
+    for (int agent_id = 0; agent_id < 2; agent_id++) {
+      State agent_state(state);
+      agent_state.agent_id = agent_id;
+      std::vector<threat_t> expected;
+      Tss tss(agent_state);
+      tss.find_all_threats(expected, THREAT_LEVEL_3, THREAT_LEVEL_5, 4);
+
+      require_same_threats(threats[agent_id], expected);
+    }
+  }
+}
+
+static void find_threats(const State & state, std::vector<threat_t> & threats, int max_depth)
+{
+  Tss tss(state);
+  tss.find_all_threats(threats, THREAT_LEVEL_3, THREAT_LEVEL_5, max_depth);
+}
+
+TEST_CASE("threat search table", "[pattern]")
+{
+  for (int round = 0; round < 10; round++) {
+    const State state = random_position(202300 + round, 40);
+
+    /* Searched from an empty table, then with entries of deeper and shallower searches */
+    for (int max_depth : { 3, 6 }) {
+      std::vector<threat_t> expected;
+      tss_table().clear();
+      find_threats(state, expected, max_depth);
+
+      for (int warm_depth : { max_depth, 2, 8 }) {
+        std::vector<threat_t> warm;
+        find_threats(state, warm, warm_depth);
+        std::vector<threat_t> threats;
+        find_threats(state, threats, max_depth);
+
+        require_same_threats(threats, expected);
+        /* Hits keep the first move of the principal line */
+        for (const threat_t & threat : threats) {
+          if (threat.final_winning && !threat.winning) {
+            REQUIRE(threat.num_children > 0);
+            const threat_t & child = tss_context().tree()[threat.first_child];
+            REQUIRE(g_threat_pattern_levels[child.match_pattern] == child.match_pattern_level);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("threat search table far from the origin", "[pattern]")
+{
+  /* Past 16 bits of cell index on large sparse boards */
+  const int size = BitBoard::geometry::size;
+  State state(size, size, BLACK);
+  state.set(size - 4, size - 7, BLACK);
+  state.set(size - 4, size - 6, BLACK);
+  state.set(size - 4, size - 5, BLACK);
+
+  std::vector<threat_t> expected;
+  tss_table().clear();
+  find_threats(state, expected, 6);
+  REQUIRE(!expected.empty());
+
+  /* Answered from the entries of the first search */
+  std::vector<threat_t> threats;
+  find_threats(state, threats, 6);
+  require_same_threats(threats, expected);
+  for (const threat_t & threat : threats) {
+    if (threat.final_winning && !threat.winning) {
+      REQUIRE(threat.num_children > 0);
+      const threat_t & child = tss_context().tree()[threat.first_child];
+      REQUIRE(child.point.i == size - 4);
+      REQUIRE(state.at(child.point.i, child.point.j) == EMPTY);
+    }
+  }
+}
+
+static void validate_tree(const std::vector<threat_t> & tree, const threat_t & threat, int & num_nodes)
+{
+  REQUIRE(threat.first_child + threat.num_children <= (int)tree.size());
+  REQUIRE(g_threat_pattern_levels[threat.match_pattern] == threat.match_pattern_level);
+  for (int k = 0; k < threat.num_children; k++) {
+    const threat_t & child = tree[threat.first_child + k];
+    if (child.final_winning) {
+      REQUIRE(threat.final_winning);
+      REQUIRE(threat.min_winning_depth <= child.min_winning_depth);
+    }
+    num_nodes++;
+    validate_tree(tree, child, num_nodes);
+  }
+}
+
+TEST_CASE("threat tree", "[pattern]")
+{
+  for (int round = 0; round < 10; round++) {
+    const State state = random_position(202500 + round, 40);
+    tss_table().clear();
+    std::vector<threat_t> threats;
+    find_threats(state, threats, 4);
+
+    /* Every node of the arena hangs below exactly one threat */
+    int num_nodes = 0;
+    for (const threat_t & threat : threats) {
+      validate_tree(tss_context().tree(), threat, num_nodes);
+    }
+    REQUIRE(num_nodes == (int)tss_context().tree().size());
+  }
+}
+
+static void validate_principal_line(const std::vector<threat_t> & tree, const threat_t & threat)
+{
+  REQUIRE(threat.num_children <= 1);
+  if (threat.num_children) {
+    const threat_t & child = tree[threat.first_child];
+    REQUIRE(child.final_winning);
+    validate_principal_line(tree, child);
+  }
+}
+
+TEST_CASE("threat principal line", "[pattern]")
+{
+  for (int round = 0; round < 10; round++) {
+    const State state = random_position(202600 + round, 40);
+    std::vector<threat_t> expected;
+    tss_table().clear();
+    find_threats(state, expected, 6);
+
+    /* Searched cold and on the entries of the full search */
+    for (int pass = 0; pass < 2; pass++) {
+      if (pass == 0) {
+        tss_table().clear();
+      }
+      std::vector<threat_t> threats;
+      Tss tss(state);
+      tss.find_all_threats(threats, THREAT_LEVEL_3, THREAT_LEVEL_5, 6, TSS_PRINCIPAL_LINE);
+
+      require_same_threats(threats, expected);
+      /* The arena holds the principal lines and nothing else */
+      int num_nodes = 0;
+      for (const threat_t & threat : threats) {
+        validate_principal_line(tss_context().tree(), threat);
+        validate_tree(tss_context().tree(), threat, num_nodes);
+      }
+      REQUIRE(num_nodes == (int)tss_context().tree().size());
+    }
+  }
+}
+
+#ifdef _PATTERN_STATS
+TEST_CASE("pattern stats", "[pattern]")
+{
+  /* An open three, which makes a winning four */
+  State state(15, 15, BLACK);
+  state.set(7, 4, BLACK);
+  state.set(7, 5, BLACK);
+  state.set(7, 6, BLACK);
+
+  pattern_stats_reset();
+  tss_table().clear();
+  /* The searches the policy runs: one color, then both in one scan */
+  std::vector<threat_t> threats;
+  std::vector<threat_t> both[2];
+  Tss tss(state, BLACK);
+  tss.find_all_threats(threats, THREAT_LEVEL_3, THREAT_LEVEL_5, 4);
+  Tss::find_all_threats_both(state, both, THREAT_LEVEL_3, THREAT_LEVEL_5, 4);
+  require_same_threats(both[BLACK], threats);
+
+  pattern_stats_t stats;
+  pattern_stats_get(stats);
+  uint64_t hits = 0;
+  uint64_t four_wins = 0;
+  uint64_t roots = 0;
+  for (int id = 0; id < g_threat_types_num; id++) {
+    REQUIRE(stats.attempts[id] >= stats.hits[id]);
+    REQUIRE(stats.hits[id] >= stats.wins[id]);
+    hits += stats.hits[id];
+    roots += stats.roots[id];
+    if (g_threat_pattern_levels[id] == 4) {
+      four_wins += stats.wins[id];
+    }
+  }
+  REQUIRE(four_wins > 0);
+  REQUIRE(stats.gain_square_tests >= hits);
+  REQUIRE(stats.gain_square_nanos > 0);
+  REQUIRE(stats.root_scans == 2);
+  REQUIRE(stats.root_cells % 3 == 0);
+  REQUIRE(stats.root_gains == roots);
+  REQUIRE(stats.root_cells >= stats.root_gains);
+  REQUIRE(roots > 0);
+}
+#endif
+
+TEST_CASE("thread pool", "[pattern]")
+{
+  ThreadPool pool(4);
+  REQUIRE(pool.size() == 4);
+  for (int num_tasks : { 0, 1, 3, 1000 }) {
+    std::vector<std::atomic<int> > runs(num_tasks);
+    for (std::atomic<int> & count : runs) {
+      count = 0;
+    }
+    bool workers_valid = true;
+    pool.run(num_tasks, [&](int task, int worker) {
+      runs[task]++;
+      if (worker < 0 || worker >= pool.size()) {
+        workers_valid = false;
+      }
+    });
+    REQUIRE(workers_valid);
+    for (const std::atomic<int> & count : runs) {
+      REQUIRE(count == 1);
+    }
+  }
+}
+
+TEST_CASE("threat search in parallel", "[pattern]")
+{
+  /* Sized apart from the host, so the split runs on a single CPU too */
+  ThreadPool pool(4);
+
+  for (int round = 0; round < 10; round++) {
+    const State state = random_position(202700 + round, 40);
+    const int mode = (round % 2) ? TSS_PRINCIPAL_LINE : TSS_FULL_TREE;
+    std::vector<threat_t> expected[2];
+    tss_table().clear();
+    Tss::find_all_threats_both(state, expected, THREAT_LEVEL_3, THREAT_LEVEL_5, 6, mode);
+
+    tss_table().clear();
+    std::vector<threat_t> threats[2];
+    Tss::find_all_threats_both(state, threats, THREAT_LEVEL_3, THREAT_LEVEL_5, 6, mode | TSS_PARALLEL, pool);
+
+    /*
+     * Only the threats must match the serial search; the merged trees
+     * index the caller's context like a serial search
+     */
+    int num_nodes = 0;
+    for (int agent_id = 0; agent_id < 2; agent_id++) {
+      require_same_threats(threats[agent_id], expected[agent_id]);
+      for (const threat_t & threat : threats[agent_id]) {
+        validate_tree(tss_context().tree(), threat, num_nodes);
+        if (mode == TSS_PRINCIPAL_LINE) {
+          validate_principal_line(tss_context().tree(), threat);
+        }
+      }
+    }
+    REQUIRE(num_nodes == (int)tss_context().tree().size());
+  }
+}
+
+TEST_CASE("threat search context", "[pattern]")
+{
+  for (int round = 0; round < 10; round++) {
+    const State state = random_position(202400 + round, 40);
+    std::vector<threat_t> threats;
+    find_threats(state, threats, 4);
+
+    TssContext & context = tss_context();
+    Tss tss(state);
+    for (const threat_t & defense : threats) {
+      /* A defense made on the context searches like a copy of the state holding it */
+      State defended(state);
+      defended.set(defense.point.i, defense.point.j, state.agent_id ^ 1);
+      Tss defended_tss(defended);
+      std::vector<std::pair<bool, int> > expected;
+      for (const threat_t & threat : threats) {
+        std::vector<threat_t> children;
+        expected.push_back(defended_tss.find_all_threats_at(threat, children, THREAT_LEVEL_3, THREAT_LEVEL_5, 4));
+      }
+
+      BitBoard & board = context.load(state.board);
+      context.make(board.index(defense.point.i, defense.point.j), state.agent_id ^ 1);
+      for (int k = 0; k < (int)threats.size(); k++) {
+        std::vector<threat_t> children;
+        REQUIRE(tss.find_all_threats_at(board, threats[k], children, THREAT_LEVEL_3, THREAT_LEVEL_5, 4) == expected[k]);
+      }
+      context.unmake();
+      REQUIRE(board.hash() == state.board.hash());
+    }
+  }
+}
+
+TEST_CASE("pattern table file", "[pattern]")
+{
+  const PatternTable generated(g_threat_automaton);
+  const std::string path = "test_pattern_tables.bin";
+  REQUIRE(generated.save(path.c_str()));
+
+  SECTION("A saved table maps back unchanged") {
+    const PatternTable mapped(g_threat_automaton, path.c_str());
+    REQUIRE(mapped.is_mapped());
+    for (unsigned window = 0; window < (1U << WINDOW_BITS); window += 7) {
+      for (int agent_id = 0; agent_id < 2; agent_id++) {
+        REQUIRE(mapped.matches(window, agent_id) == generated.matches(window, agent_id));
+        REQUIRE(mapped.first_match_pos(window, agent_id) == generated.first_match_pos(window, agent_id));
+      }
+    }
+  }
+
+  SECTION("A damaged or missing file is generated again") {
+    FILE * file = fopen(path.c_str(), "r+b");
+    REQUIRE(file != NULL);
+    fseek(file, -1, SEEK_END);
+    fputc(0x5a, file);
+    fclose(file);
+
+    const PatternTable damaged(g_threat_automaton, path.c_str());
+    REQUIRE(!damaged.is_mapped());
+    REQUIRE(damaged.matches(0xaaaa, BLACK) == generated.matches(0xaaaa, BLACK));
+
+    remove(path.c_str());
+    const PatternTable missing(g_threat_automaton, path.c_str());
+    REQUIRE(!missing.is_mapped());
+  }
+
+  remove(path.c_str());
+}
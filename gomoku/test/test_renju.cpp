@@ -0,0 +1,196 @@
+#include "test_base.h"
+
+#include <random>
+
+#include "../fast_tss.h"
+#include "../renju.h"
+
+using namespace mcts;
+
+static int check_at(const StrPosition & str_board, int row, int col)
+{
+  Position position(15, Row(15, EMPTY));
+  str_2_position(str_board, position);
+  BitBoard board(15, 15);
+  board.load(position);
+  return renju_check(board, board.index(row, col));
+}
+
+TEST_CASE("renju forbidden moves", "[renju]")
+{
+  SECTION("Two open threes") {
+    const StrPosition str_board {
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      ".......o.......",
+      ".......o.......",
+      ".....oo........",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "..............."
+    };
+    REQUIRE(check_at(str_board, 7, 7) == RENJU_DOUBLE_THREE);
+  }
+
+  SECTION("A three closed by white is not open") {
+    const StrPosition str_board {
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      ".......o.......",
+      ".......o.......",
+      "....xoo........",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "..............."
+    };
+    REQUIRE(check_at(str_board, 7, 7) == RENJU_LEGAL);
+  }
+
+  SECTION("A three whose fours would be overlines is not open") {
+    const StrPosition str_board {
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      ".......o.......",
+      ".......o.......",
+      "..o..oo...o....",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "..............."
+    };
+    REQUIRE(check_at(str_board, 7, 7) == RENJU_LEGAL);
+  }
+
+  SECTION("Fours on two lines") {
+    const StrPosition str_board {
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "....o..........",
+      ".....o.........",
+      "......o........",
+      "....ooo........",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "..............."
+    };
+    REQUIRE(check_at(str_board, 7, 7) == RENJU_DOUBLE_FOUR);
+  }
+
+  SECTION("Two fours on one line") {
+    const StrPosition str_board {
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...o.o.o.o.....",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "..............."
+    };
+    REQUIRE(check_at(str_board, 7, 6) == RENJU_DOUBLE_FOUR);
+  }
+
+  SECTION("Six in a row") {
+    const StrPosition str_board {
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "..oo.ooo.......",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "..............."
+    };
+    REQUIRE(check_at(str_board, 7, 4) == RENJU_OVERLINE);
+  }
+
+  SECTION("Five wins over a double four") {
+    const StrPosition str_board {
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "....o..........",
+      ".....o.........",
+      "......o........",
+      "...oooo........",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "...............",
+      "..............."
+    };
+    REQUIRE(check_at(str_board, 7, 7) == RENJU_FIVE);
+  }
+}
+
+TEST_CASE("renju rule updates", "[renju]")
+{
+  std::mt19937 random_gen(2022);
+
+  for (int round = 0; round < 10; round++) {
+    BitBoard board(15, 15);
+    RenjuRule rule;
+
+    /* Dense black to get forbidden cells, and some white */
+    for (int k = 0; k < 70; k++) {
+      const int index = board.index(3 + random_gen() % 9, 3 + random_gen() % 9);
+      const char value = (random_gen() % 4 == 0) ? WHITE : ((random_gen() % 5 == 0) ? EMPTY : BLACK);
+      board.set(index, value);
+      rule.update(board, index);
+
+      for (int i = 0; i < 15; i++) {
+        for (int j = 0; j < 15; j++) {
+          const int cell = board.index(i, j);
+          const bool forbidden = board.at(cell) == EMPTY && renju_check(board, cell) >= RENJU_OVERLINE;
+          REQUIRE(rule.is_forbidden(board, cell) == forbidden);
+          if (board.at(cell) == EMPTY) {
+            REQUIRE(renju_is_forbidden(board, cell) == forbidden);
+          }
+        }
+      }
+    }
+  }
+}
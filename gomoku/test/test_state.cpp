@@ -0,0 +1,476 @@
+#include "test_base.h"
+
+#include <random>
+#include <vector>
+
+#include "../fast_tss.h"
+#include "../sparse_board.h"
+#include "../state.h"
+
+using namespace mcts;
+
+TEST_CASE("state hash", "[state]")
+{
+  State state(15, 15, BLACK);
+
+  SECTION("Empty boards with the same side share a hash") {
+    State other(15, 15, BLACK);
+    REQUIRE(state.hash() == other.hash());
+  }
+
+  SECTION("Hash does not depend on move order") {
+    State other(15, 15, BLACK);
+    state.set(7, 7, BLACK);
+    state.set(7, 8, WHITE);
+    state.set(8, 8, BLACK);
+    other.set(8, 8, BLACK);
+    other.set(7, 8, WHITE);
+    other.set(7, 7, BLACK);
+    REQUIRE(state.hash() == other.hash());
+  }
+
+  SECTION("Clearing a stone restores the hash") {
+    const uint64_t empty_hash = state.hash();
+    state.set(3, 4, WHITE);
+    REQUIRE(state.hash() != empty_hash);
+    state.set(3, 4, BLACK);
+    state.set(3, 4, EMPTY);
+    REQUIRE(state.hash() == empty_hash);
+  }
+
+  SECTION("Hash matches a freshly loaded position") {
+    Position position(15, Row(15, EMPTY));
+    position[0][0] = BLACK;
+    position[14][14] = WHITE;
+    position[7][3] = BLACK;
+    State loaded(15, 15, position, BLACK);
+    state.set(7, 3, BLACK);
+    state.set(14, 14, WHITE);
+    state.set(0, 0, BLACK);
+    REQUIRE(state.hash() == loaded.hash());
+  }
+
+  SECTION("Side to move is folded into the hash") {
+    State other(state);
+    other.agent_id = WHITE;
+    REQUIRE(state.hash() != other.hash());
+    REQUIRE(state.board.hash() == other.board.hash());
+  }
+}
+
+void validate_windows(const BitBoard& board)
+{
+  for (int row = 0; row < board.height(); ++row) {
+    for (int col = 0; col < board.width(); ++col) {
+      for (int dir = 0; dir < NUM_DIR; ++dir) {
+        const unsigned window = board.window(row, col, dir);
+        for (int k = -WINDOW_RADIUS; k <= WINDOW_RADIUS; ++k) {
+          const int i = row + k * BOARD_DIRS[dir][ROW];
+          const int j = col + k * BOARD_DIRS[dir][COL];
+          const int expected = in_boundary(i, j, board.width(), board.height()) ?
+                               board.at(i, j) : WALL;
+          REQUIRE((int)window_cell(window, k + WINDOW_RADIUS) == expected);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("board line windows", "[state]")
+{
+  SECTION("Windows follow stones on a full size board") {
+    BitBoard board(15, 15);
+    board.set(0, 0, BLACK);
+    board.set(7, 7, WHITE);
+    board.set(14, 3, BLACK);
+    board.set(2, 12, WHITE);
+    board.set(7, 7, EMPTY);
+    board.set(8, 6, BLACK);
+    validate_windows(board);
+  }
+
+  SECTION("Windows see WALL around a smaller board") {
+    BitBoard board(9, 9);
+    board.set(8, 8, WHITE);
+    board.set(4, 0, BLACK);
+    validate_windows(board);
+  }
+
+  SECTION("Rays walk BOARD_DIRS forwards and backwards") {
+    const auto & rays = BitBoard::geometry::rays;
+    const int index = BitBoard::index(7, 7);
+    for (int ray = 0; ray < NUM_RAYS; ray++) {
+      const int dir = rays.dir[ray];
+      const int sign = (ray < NUM_DIR) ? 1 : -1;
+      REQUIRE(dir == ray % NUM_DIR);
+      for (int k = 0; k <= BOARD_PAD; k++) {
+        REQUIRE(index + rays.steps[ray][k] ==
+                BitBoard::index(7 + sign * k * BOARD_DIRS[dir][ROW], 7 + sign * k * BOARD_DIRS[dir][COL]));
+      }
+    }
+  }
+}
+
+TEST_CASE("last move win check", "[state]")
+{
+  State state(15, 15, BLACK);
+
+  SECTION("Five through the last stone in every direction") {
+    const int dirs[][2] = { {1, 0}, {0, 1}, {1, 1}, {-1, 1} };
+    for (const auto & dir : dirs) {
+      State line(15, 15, BLACK);
+      for (int k = 0; k < NUMTOWIN; k++) {
+        if (k != 2) {
+          line.set(7 + (k - 2) * dir[0], 7 + (k - 2) * dir[1], WHITE);
+        }
+      }
+      line.set(7, 7, WHITE);
+      REQUIRE(util_check_win_at(line.board, 7, 7) == WHITE);
+      REQUIRE(sim_check_win(line) == WHITE);
+      REQUIRE(util_check_win(line.board) == WHITE);
+    }
+  }
+
+  SECTION("Broken and edge lines are not a win") {
+    for (int j = 0; j < 4; j++) {
+      state.set(0, j, BLACK);
+    }
+    state.set(0, 4, WHITE);
+    REQUIRE(util_check_win_at(state.board, 0, 4) == NOT_END);
+    REQUIRE(sim_check_win(state) == NOT_END);
+    state.set(1, 0, BLACK);
+    state.set(2, 0, BLACK);
+    REQUIRE(util_check_win_at(state.board, 0, 0) == NOT_END);
+    REQUIRE(util_check_win(state.board) == NOT_END);
+  }
+
+  SECTION("Full board without a five is a tie") {
+    State small(3, 3, BLACK);
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        small.set(i, j, (i + j) % 2 ? WHITE : BLACK);
+      }
+    }
+    REQUIRE(small.has_last_move());
+    REQUIRE(sim_check_win(small) == EMPTY);
+  }
+
+  SECTION("Off-diagonal AI move found by position diff") {
+    // The same steps main.cpp takes after the AI moves
+    Position before(15, Row(15, EMPTY));
+    for (int j = 3; j < 7; j++) {
+      before[2][j] = BLACK;
+    }
+    Position after = before;
+    after[2][7] = BLACK;
+    point_t point;
+    find_position_diff(before, after, point);
+    REQUIRE(sim_check_win(after, point.j, point.i) == BLACK);
+
+    after = before;
+    after[2][8] = BLACK;
+    find_position_diff(before, after, point);
+    REQUIRE(sim_check_win(after, point.j, point.i) == NOT_END);
+  }
+}
+
+TEST_CASE("state play and undo", "[state]")
+{
+  State state(15, 15, WHITE);
+  state.set(7, 7, BLACK);
+  const State before(state);
+
+  const move_t moves[] = { move_t(7, 8), move_t(8, 8), move_t(0, 0), move_t(14, 13) };
+  for (const auto & move : moves) {
+    state.play(move);
+  }
+
+  SECTION("Play alternates sides and records the move") {
+    REQUIRE(state.history_size() == 4);
+    REQUIRE(state.agent_id == WHITE);
+    REQUIRE(state.at(7, 8) == BLACK);
+    REQUIRE(state.at(8, 8) == WHITE);
+    REQUIRE(state.last_move == move_t(14, 13));
+  }
+
+  SECTION("Undo restores the board and its derived data") {
+    for (int k = 0; k < 4; k++) {
+      state.undo();
+    }
+    REQUIRE(state.history_size() == 0);
+    REQUIRE(state.agent_id == before.agent_id);
+    REQUIRE(state.last_move == before.last_move);
+    REQUIRE(state.hash() == before.hash());
+    for (int i = 0; i < 15; i++) {
+      for (int j = 0; j < 15; j++) {
+        REQUIRE(state.at(i, j) == before.at(i, j));
+        for (int dir = 0; dir < NUM_DIR; dir++) {
+          REQUIRE(state.board.window(i, j, dir) == before.board.window(i, j, dir));
+        }
+      }
+    }
+  }
+
+  SECTION("Copies keep their history") {
+    State other(state);
+    other.undo();
+    REQUIRE(other.last_move == move_t(0, 0));
+    REQUIRE(other.at(14, 13) == EMPTY);
+    REQUIRE(state.at(14, 13) == WHITE);
+  }
+}
+
+TEST_CASE("stone counts and bounding box", "[state]")
+{
+  State state(15, 15, BLACK);
+  int top, left, bottom, right;
+
+  SECTION("Empty board has an empty box") {
+    state.board.bounding_box(4, top, left, bottom, right);
+    REQUIRE(top > bottom);
+    REQUIRE(state.board.stone_count() == 0);
+  }
+
+  SECTION("Box follows the stones and clips the margin") {
+    state.set(2, 9, BLACK);
+    state.set(5, 3, WHITE);
+    state.set(6, 6, BLACK);
+    REQUIRE(state.board.count(BLACK) == 2);
+    REQUIRE(state.board.count(WHITE) == 1);
+    state.board.bounding_box(0, top, left, bottom, right);
+    REQUIRE((top == 2 && left == 3 && bottom == 6 && right == 9));
+    state.board.bounding_box(4, top, left, bottom, right);
+    REQUIRE((top == 0 && left == 0 && bottom == 10 && right == 13));
+
+    state.set(2, 9, EMPTY);
+    state.set(5, 3, BLACK);
+    REQUIRE(state.board.count(BLACK) == 2);
+    REQUIRE(state.board.count(WHITE) == 0);
+    state.board.bounding_box(1, top, left, bottom, right);
+    REQUIRE((top == 4 && left == 2 && bottom == 7 && right == 7));
+  }
+}
+
+#ifndef _SPARSE_BOARD
+TEST_CASE("sparse board", "[state]")
+{
+  std::mt19937 random_gen(2017);
+  BasicBitBoard<geometry_t> dense(15, 15);
+  SparseBoard sparse(15, 15);
+
+  /* Random stones and removals, then the same queries on both boards */
+  for (int step = 0; step < 400; step++) {
+    const int row = random_gen() % 15;
+    const int col = random_gen() % 15;
+    const char value = (step % 3 == 2) ? EMPTY : (char)(random_gen() % 2);
+    dense.set(row, col, value);
+    sparse.set(row, col, value);
+
+    REQUIRE(sparse.hash() == dense.hash());
+    REQUIRE(sparse.count(BLACK) == dense.count(BLACK));
+    REQUIRE(sparse.count(WHITE) == dense.count(WHITE));
+
+    int box[2][4];
+    dense.bounding_box(4, box[0][0], box[0][1], box[0][2], box[0][3]);
+    sparse.bounding_box(4, box[1][0], box[1][1], box[1][2], box[1][3]);
+    for (int k = 0; k < 4; k++) {
+      REQUIRE(box[1][k] == box[0][k]);
+    }
+  }
+
+  for (int row = -2; row < 17; row++) {
+    for (int col = -2; col < 17; col++) {
+      const int index = BitBoard::index(row, col);
+      REQUIRE(sparse.at(index) == dense.at(index));
+      if (row >= 0 && row < 15 && col >= 0 && col < 15) {
+        for (int dir = 0; dir < NUM_DIR; dir++) {
+          REQUIRE(sparse.window(row, col, dir) == dense.window(row, col, dir));
+        }
+      }
+    }
+  }
+
+  Position position;
+  dense.store(position);
+  SparseBoard loaded(15, 15);
+  loaded.load(position);
+  REQUIRE(loaded.hash() == dense.hash());
+}
+#endif
+
+/* Level the cache should hold, looked up from scratch */
+static int threat_level_at(const BitBoard & board, int row, int col, int agent_id, int dir)
+{
+  if (board.at(row, col) != EMPTY) {
+    return 0;
+  }
+  const uint32_t level_2_ids = (2U << g_threat_levels[THREAT_LEVEL_2][BEGIN]) - 1;
+  const uint32_t matches = threat_pattern_table().matches(board.window(row, col, dir), agent_id) & level_2_ids;
+  return (matches) ? g_threat_pattern_levels[__builtin_ctz(matches)] : 0;
+}
+
+static void require_threat_cache(const BitBoard & board, const ThreatCache & cache)
+{
+  for (int i = 0; i < 15; i++) {
+    for (int j = 0; j < 15; j++) {
+      const int index = BitBoard::index(i, j);
+      for (int agent_id = 0; agent_id < 2; agent_id++) {
+        int best = 0;
+        for (int dir = 0; dir < NUM_DIR; dir++) {
+          const int level = threat_level_at(board, i, j, agent_id, dir);
+          REQUIRE(cache.level(index, agent_id, dir) == level);
+          best = std::max(best, level);
+        }
+        REQUIRE(cache.best_level(index, agent_id) == best);
+      }
+    }
+  }
+}
+
+TEST_CASE("threat cache", "[state]")
+{
+  std::mt19937 random_gen(2020);
+  State state(15, 15, WHITE);
+
+  SECTION("Updates keep the cache in step with play and undo") {
+    ThreatCache cache;
+    cache.reset(state.board);
+    std::vector<move_t> moves;
+    for (int k = 0; k < 60; k++) {
+      const move_t move(random_gen() % 15, random_gen() % 15);
+      if (state.at(move.first, move.second) == EMPTY) {
+        state.play(move);
+        moves.push_back(move);
+        cache.update(state.board, BitBoard::index(move.first, move.second));
+        require_threat_cache(state.board, cache);
+      }
+    }
+    while (!moves.empty()) {
+      state.undo();
+      cache.update(state.board, BitBoard::index(moves.back().first, moves.back().second));
+      moves.pop_back();
+      require_threat_cache(state.board, cache);
+    }
+  }
+
+  SECTION("The search context follows the board it is asked about") {
+    for (int k = 0; k < 50; k++) {
+      state.set(random_gen() % 15, random_gen() % 15, (char)(random_gen() % 3));
+    }
+    require_threat_cache(state.board, tss_context().threat_cache(state.board));
+
+    Position position;
+    state.get_position(position);
+    const State loaded(15, 15, position, BLACK);
+    require_threat_cache(loaded.board, tss_context().threat_cache(loaded.board));
+
+    state.set(7, 7, (state.at(7, 7) == BLACK) ? WHITE : BLACK);
+    require_threat_cache(state.board, tss_context().threat_cache(state.board));
+  }
+}
+
+/* FORK_* of a stone of agent_id at (7, 7) */
+static int center_fork(const State & state, int agent_id)
+{
+  return tss_context().threat_cache(state.board).fork(BitBoard::index(7, 7), agent_id);
+}
+
+TEST_CASE("fork detection", "[state]")
+{
+  State state(15, 15, WHITE);
+
+  SECTION("Two open twos crossing make a three-three") {
+    state.set(7, 5, BLACK);
+    state.set(7, 6, BLACK);
+    state.set(5, 7, BLACK);
+    state.set(6, 7, BLACK);
+    REQUIRE(center_fork(state, BLACK) == FORK_THREE_THREE);
+    REQUIRE(center_fork(state, WHITE) == FORK_NONE);
+  }
+
+  SECTION("A three crossing an open two makes a four-three") {
+    state.set(7, 4, BLACK);
+    state.set(7, 5, BLACK);
+    state.set(7, 6, BLACK);
+    state.set(5, 7, BLACK);
+    state.set(6, 7, BLACK);
+    REQUIRE(center_fork(state, BLACK) == FORK_FOUR_THREE);
+  }
+
+  SECTION("Two threes crossing make a four-four") {
+    state.set(7, 4, BLACK);
+    state.set(7, 5, BLACK);
+    state.set(7, 6, BLACK);
+    state.set(4, 4, BLACK);
+    state.set(5, 5, BLACK);
+    state.set(6, 6, BLACK);
+    REQUIRE(center_fork(state, BLACK) == FORK_FOUR_FOUR);
+
+    std::vector<move_t> forks;
+    REQUIRE(find_forks(state, BLACK, forks) == FORK_FOUR_FOUR);
+    REQUIRE(std::find(forks.begin(), forks.end(), move_t(7, 7)) != forks.end());
+  }
+
+  SECTION("A five is no four") {
+    state.set(7, 3, BLACK);
+    state.set(7, 4, BLACK);
+    state.set(7, 5, BLACK);
+    state.set(7, 6, BLACK);
+    state.set(5, 7, BLACK);
+    state.set(6, 7, BLACK);
+    REQUIRE(center_fork(state, BLACK) == FORK_NONE);
+    REQUIRE(find_top_threat_level(state, BLACK) == 5);
+  }
+
+  SECTION("A three gives a four as the top threat") {
+    state.set(7, 4, BLACK);
+    state.set(7, 5, BLACK);
+    state.set(7, 6, BLACK);
+    REQUIRE(find_top_threat_level(state, BLACK) == ThreatCache::FOUR_LEVEL);
+    REQUIRE(find_top_threat_level(state, WHITE) == 0);
+  }
+
+  SECTION("A four-three plays through a three of the opponent") {
+    state.set(7, 4, BLACK);
+    state.set(7, 5, BLACK);
+    state.set(7, 6, BLACK);
+    state.set(5, 7, BLACK);
+    state.set(6, 7, BLACK);
+    state.set(11, 3, WHITE);
+    state.set(11, 4, WHITE);
+    state.set(11, 5, WHITE);
+    REQUIRE(find_top_threat_level(state, WHITE) == ThreatCache::FOUR_LEVEL);
+
+    std::vector<move_t> moves;
+    REQUIRE(find_fork_moves(state, moves) == POLICY_SUCCESS);
+    REQUIRE(std::find(moves.begin(), moves.end(), move_t(7, 7)) != moves.end());
+  }
+
+  SECTION("A three-three gives way to a four of the opponent") {
+    state.set(7, 5, BLACK);
+    state.set(7, 6, BLACK);
+    state.set(5, 7, BLACK);
+    state.set(6, 7, BLACK);
+
+    std::vector<move_t> moves;
+    REQUIRE(find_fork_moves(state, moves) == POLICY_SUCCESS);
+    REQUIRE(std::find(moves.begin(), moves.end(), move_t(7, 7)) != moves.end());
+
+    state.set(11, 3, WHITE);
+    state.set(11, 4, WHITE);
+    state.set(11, 5, WHITE);
+    moves.clear();
+    REQUIRE(find_fork_moves(state, moves) == POLICY_FAIL);
+    REQUIRE(moves.empty());
+  }
+
+  SECTION("A blocked line is no threat") {
+    state.set(7, 5, BLACK);
+    state.set(7, 6, BLACK);
+    state.set(7, 8, WHITE);
+    state.set(5, 7, BLACK);
+    state.set(6, 7, BLACK);
+    state.set(8, 7, WHITE);
+    REQUIRE(center_fork(state, BLACK) == FORK_NONE);
+  }
+}
@@ -24,18 +24,18 @@ int main(int argc, char * argv[])
       char c;
       in >> c;
       if (c == 'O')
-        state.position[i][j] = mcts::BLACK;
+        state.set(i, j, mcts::BLACK);
       if (c == 'X')
-        state.position[i][j] = mcts::WHITE;
+        state.set(i, j, mcts::WHITE);
       if (c == '.')
-        state.position[i][j] = mcts::EMPTY;
+        state.set(i, j, mcts::EMPTY);
     }
   }
   cout << state << endl;
 
   mcts::Tss tss(state);
   std::vector<mcts::threat_t> threats;
-  tss.find_all_threats(state.position, threats, THREAT_LEVEL_3, THREAT_LEVEL_5, 12);
+  tss.find_all_threats(state.board, threats, THREAT_LEVEL_3, THREAT_LEVEL_5, 12);
   sort(threats.begin(), threats.end(), greater<mcts::threat_t>());
 
   cout << "original" << endl;
@@ -22,9 +22,9 @@ pair<int, int> count(const State & s, int w, int h)
 
     for (int i = 0; i < h; i++){
         for (int j = 0; j < w; j++) {
-            if (s.position[i][j] == BLACK)
+            if (s.at(i, j) == BLACK)
                 res.first++;
-            if (s.position[i][j] == WHITE)
+            if (s.at(i, j) == WHITE)
                 res.second++;
         }
     }
@@ -36,7 +36,7 @@ State run(const State & state, bool is_cpu, bool * is_over)
 {
     int winner = EMPTY;
     cout << state << endl;
-    if ((winner = util_check_win(state.position, state.board_width, state.board_height)) != NOT_END) {
+    if ((winner = util_check_win(state.board)) != NOT_END) {
         if (winner == EMPTY)
           cout << "Tie" << endl;
         else
@@ -66,11 +66,11 @@ State run(const State & state, bool is_cpu, bool * is_over)
                 *is_over = true;
                 return state;
             }
-        }while(state.position[row][col] != EMPTY);
+        }while(state.at(row, col) != EMPTY);
 
         State new_state(state);
         new_state.agent_id ^= (1 << 0);
-        new_state.position[row][col] = new_state.agent_id;
+        new_state.set(row, col, new_state.agent_id);
 
         return new_state;
     }
@@ -89,11 +89,11 @@ int main(int argc, char * argv[])
       char c;
       in >> c;
       if (c == '.')
-      state.position[i][j] = EMPTY;
+      state.set(i, j, EMPTY);
       if (c == 'O')
-      state.position[i][j] = BLACK;
+      state.set(i, j, BLACK);
       if (c == 'X')
-      state.position[i][j] = WHITE;
+      state.set(i, j, WHITE);
     }
   }
 
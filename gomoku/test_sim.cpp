@@ -25,9 +25,9 @@ pair<int, int> count(const State & s, int w, int h)
 
     for (int i = 0; i < h; i++){
         for (int j = 0; j < w; j++) {
-            if (s.position[i][j] == BLACK)
+            if (s.at(i, j) == BLACK)
                 res.first++;
-            if (s.position[i][j] == WHITE)
+            if (s.at(i, j) == WHITE)
                 res.second++;
         }
     }
@@ -53,7 +53,7 @@ int main(int argc, char * argv[])
     for (int j = 0; j < 15; j++) {
       int val;
       in >> val;
-      state.position[i][j] = val;
+      state.set(i, j, val);
     }
   }
 
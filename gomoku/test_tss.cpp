@@ -21,7 +21,7 @@ int main()
 
   Tss tss(state);
   std::vector<Tss::threat_t> threats;
-  tss.find_all_threats(state.position, threats, THREAT_LEVEL_3, THREAT_LEVEL_5);
+  tss.find_all_threats(state.board, threats, THREAT_LEVEL_3, THREAT_LEVEL_5);
 
   /*
   for (Tss::threat_t threat : threats) {
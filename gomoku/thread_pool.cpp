@@ -0,0 +1,80 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace mcts
+{
+
+ThreadPool::ThreadPool(int num_threads):
+  m_generation(0),
+  m_busy(0),
+  m_stop(false),
+  m_task(NULL),
+  m_num_tasks(0),
+  m_next_task(0)
+{
+  if (num_threads <= 0) {
+    num_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  for (int worker = 0; worker < num_threads; worker++) {
+    m_threads.emplace_back(&ThreadPool::work, this, worker);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_start.notify_all();
+  for (std::thread & thread : m_threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::run(int num_tasks, const std::function<void(int, int)> & task)
+{
+  if (num_tasks <= 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> run_lock(m_run_mutex);
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_task = &task;
+  m_num_tasks = num_tasks;
+  m_next_task.store(0, std::memory_order_relaxed);
+  m_busy = size();
+  m_generation++;
+  m_start.notify_all();
+  m_done.wait(lock, [this] { return m_busy == 0; });
+  m_task = NULL;
+}
+
+void ThreadPool::work(int worker)
+{
+  int generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_start.wait(lock, [&] { return m_stop || m_generation != generation; });
+      if (m_stop) {
+        return;
+      }
+      generation = m_generation;
+    }
+
+    for (int index = m_next_task.fetch_add(1, std::memory_order_relaxed);
+         index < m_num_tasks;
+         index = m_next_task.fetch_add(1, std::memory_order_relaxed)) {
+      (*m_task)(index, worker);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_busy == 0) {
+      m_done.notify_one();
+    }
+  }
+}
+
+}
@@ -0,0 +1,67 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mcts
+{
+
+/*
+ * Worker threads kept alive from run to run, so a parallel search only
+ * pays for waking them up.
+ * run() hands out task indices one at a time, the workers taking the
+ * next one as they finish, and returns once all are done; the caller
+ * only waits. Runs from several threads are served one after another.
+ */
+class ThreadPool
+{
+public:
+  /*
+   * @param[IN] num_threads workers, 0 for one per hardware thread
+   * */
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  int size() const
+  {
+    return (int)m_threads.size();
+  }
+
+  /*
+   * @brief call task(index, worker) for every index in [0, num_tasks),
+   *        worker in [0, size()) naming the thread running it
+   * */
+  void run(int num_tasks, const std::function<void(int, int)> & task);
+
+private:
+  std::vector<std::thread> m_threads;
+  /* Held by run() throughout, so only one run is in progress */
+  std::mutex m_run_mutex;
+
+  std::mutex m_mutex;
+  std::condition_variable m_start;
+  std::condition_variable m_done;
+  /* Bumped by every run, waking the workers */
+  int m_generation;
+  /* Workers still busy with the run in progress */
+  int m_busy;
+  bool m_stop;
+
+  const std::function<void(int, int)> * m_task;
+  int m_num_tasks;
+  std::atomic<int> m_next_task;
+
+  void work(int worker);
+};
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include "threat_cache.h"
+#include "fast_tss.h"
+
+namespace mcts
+{
+
+/* Patterns of THREAT_LEVEL_2 and up */
+static const uint32_t g_cached_ids = (2U << g_threat_levels[THREAT_LEVEL_2][BEGIN]) - 1;
+
+const int ThreatCache::THREE_LEVEL;
+const int ThreatCache::FOUR_LEVEL;
+
+ThreatCache::ThreatCache()
+{
+#ifndef _SPARSE_BOARD
+  std::fill(m_levels, m_levels + BitBoard::geometry::cells, 0);
+#endif
+}
+
+void ThreatCache::reset(const BitBoard & board)
+{
+#ifdef _SPARSE_BOARD
+  m_levels.clear();
+#else
+  std::fill(m_levels, m_levels + BitBoard::geometry::cells, 0);
+#endif
+  int top, left, bottom, right;
+  board.bounding_box(0, top, left, bottom, right);
+  for (int i = top; i <= bottom; i++) {
+    for (int j = left; j <= right; j++) {
+      if (board.at(i, j) != EMPTY) {
+        update(board, board.index(i, j));
+      }
+    }
+  }
+}
+
+void ThreatCache::update(const BitBoard & board, int index)
+{
+  const PatternTable & table = threat_pattern_table();
+
+  for (int dir = 0; dir < NUM_DIR; dir++) {
+    const int offset = BitBoard::geometry::offset(dir);
+    for (int k = -WINDOW_RADIUS; k <= WINDOW_RADIUS; k++) {
+      const int cell = index + k * offset;
+      const char value = board.at(cell);
+      if (value == WALL) {
+        continue;
+      }
+
+      uint32_t packed = levels(cell);
+      for (int agent_id = 0; agent_id < 2; agent_id++) {
+        int level = 0;
+        if (value == EMPTY) {
+          /* The table ignores the center, which stands for the new stone */
+          const unsigned window = board.window(BitBoard::geometry::row(cell), BitBoard::geometry::col(cell), dir);
+          const uint32_t matches = table.matches(window, agent_id) & g_cached_ids;
+          level = (matches) ? g_threat_pattern_levels[__builtin_ctz(matches)] : 0;
+        }
+        packed = (packed & ~(LEVEL_MASK << shift(agent_id, dir))) | ((uint32_t)level << shift(agent_id, dir));
+      }
+      store(cell, packed);
+    }
+  }
+}
+
+void ThreatCache::store(int index, uint32_t packed)
+{
+#ifdef _SPARSE_BOARD
+  if (packed) {
+    m_levels[index] = packed;
+  } else {
+    m_levels.erase(index);
+  }
+#else
+  m_levels[index] = packed;
+#endif
+}
+
+}
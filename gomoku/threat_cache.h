@@ -0,0 +1,132 @@
+#ifndef _THREAT_CACHE_H_
+#define _THREAT_CACHE_H_
+
+#include <algorithm>
+#include <cstdint>
+
+#include "bitboard.h"
+#include "constants.h"
+
+/* Double threats, weakest first */
+#define FORK_NONE 0
+#define FORK_THREE_THREE 1
+#define FORK_FOUR_THREE 2
+#define FORK_FOUR_FOUR 3
+
+namespace mcts
+{
+
+/*
+ * Threat level (g_threat_pattern_levels) every empty cell would get if
+ * either color played there, for each of the NUM_DIR lines through it.
+ * A stone only changes the windows of the WINDOW_RADIUS cells on each
+ * side of it along each line, so update() touches 4 * WINDOW_CELLS cells
+ * instead of rescanning the board.
+ * Only levels from THREAT_LEVEL_2 up are kept: a lone stone (level 1)
+ * fits almost everywhere and carries no information.
+ */
+class ThreatCache
+{
+public:
+  /* g_threat_pattern_levels of the threes and the fours */
+  static const int THREE_LEVEL = 3;
+  static const int FOUR_LEVEL = 4;
+
+  ThreatCache();
+
+  /*
+   * @brief rebuild from the stones of board
+   * */
+  void reset(const BitBoard & board);
+
+  /*
+   * @brief refresh the cells whose windows hold index, after board.set()
+   * */
+  void update(const BitBoard & board, int index);
+
+  /*
+   * @return level of the best pattern agent_id would match at index
+   *         along BOARD_DIRS[dir], 0 for none or for a stone
+   * */
+  int level(int index, int agent_id, int dir) const
+  {
+    return (levels(index) >> shift(agent_id, dir)) & LEVEL_MASK;
+  }
+
+  /*
+   * @return best level of agent_id at index over all directions
+   * */
+  int best_level(int index, int agent_id) const
+  {
+    int best = 0;
+    for (uint32_t packed = (levels(index) >> shift(agent_id, 0)) & 0xffff; packed; packed >>= LEVEL_BITS) {
+      best = std::max(best, (int)(packed & LEVEL_MASK));
+    }
+    return best;
+  }
+
+  /*
+   * @return FORK_* of a stone of agent_id at index: threats on two
+   *         different lines, which one move cannot both block; a five
+   *         wins outright and counts as no four
+   * */
+  int fork(int index, int agent_id) const
+  {
+    int fours = 0;
+    int threes = 0;
+    for (uint32_t packed = (levels(index) >> shift(agent_id, 0)) & 0xffff; packed; packed >>= LEVEL_BITS) {
+      const int level = packed & LEVEL_MASK;
+      fours += (level == FOUR_LEVEL);
+      threes += (level == THREE_LEVEL);
+    }
+    if (fours >= 2) {
+      return FORK_FOUR_FOUR;
+    } else if (fours == 1 && threes >= 1) {
+      return FORK_FOUR_THREE;
+    } else if (threes >= 2) {
+      return FORK_THREE_THREE;
+    }
+    return FORK_NONE;
+  }
+
+  /*
+   * @brief whether any color has a threat at index
+   * */
+  bool any(int index) const
+  {
+    return levels(index) != 0;
+  }
+
+private:
+  static const int LEVEL_BITS = 4;
+  static const uint32_t LEVEL_MASK = (1U << LEVEL_BITS) - 1;
+
+  /* Bits 4 * dir of the low half for BLACK, of the high half for WHITE */
+#ifdef _SPARSE_BOARD
+  SparseCellMap<uint32_t> m_levels;
+
+  uint32_t levels(int index) const
+  {
+    const uint32_t * packed = m_levels.find(index);
+    return (packed) ? *packed : 0;
+  }
+#else
+  uint32_t m_levels[BitBoard::geometry::cells];
+
+  uint32_t levels(int index) const
+  {
+    return m_levels[index];
+  }
+#endif
+
+  static int shift(int agent_id, int dir)
+  {
+    return agent_id * NUM_DIR * LEVEL_BITS + dir * LEVEL_BITS;
+  }
+
+  void store(int index, uint32_t packed);
+};
+
+}
+
+#endif
@@ -12,6 +12,15 @@
 namespace mcts
 {
 
+/*
+ * Progressive widening: children are opened in policy order, and a node
+ * with n simulations keeps at most 1 + n^kWideningExponent of them open.
+ * move_balance() puts the threat moves first, so the exploration moves
+ * cannot draw visits away from them until the node has enough
+ * simulations to tell the moves apart.
+ */
+const double kWideningExponent = 0.3;
+
 class TreeNode
 {
 public:
@@ -29,7 +38,16 @@ public:
   bool is_fully_expanded() const
   {
     return (!children.empty()) &&
-           (children.size() == actions.size());
+           (children.size() == actions.size() ||
+            children.size() >= max_open_children());
+  }
+
+  /*
+   * @brief children the node may have open after its simulations so far
+   * */
+  size_t max_open_children() const
+  {
+    return 1 + (size_t)pow(simulation_count, kWideningExponent);
   }
 
   bool is_game_finished() const
@@ -104,16 +122,7 @@ public:
     }
     if (actions.empty()) {
       int strategy = 0;
-      const auto& position = state.position;
-      int stone_count = 0;
-      for (size_t y = 0; y < position.size(); ++y) {
-        const auto& row = position[y];
-        for (size_t x = 0; x < row.size(); ++x) {
-          if (row[x] != EMPTY) {
-            stone_count += 1;
-          }
-        }
-      }
+      int stone_count = state.board.stone_count();
       if (stone_count > 1) {
         strategy = STRATEGY_BALANCE;
       } else {
@@ -30,7 +30,7 @@
 
 namespace mcts
 {
-const static char * g_threat_types[] = {
+constexpr const char * g_threat_types[] = {
   /* Five */
   "ooooo", // 0
 
@@ -73,7 +73,13 @@ const static int g_threat_levels[][2] = {
     {0, 0}
 };
 
-const static int g_threat_types_num = sizeof(g_threat_types) / sizeof(char *);
+constexpr int g_threat_types_num = sizeof(g_threat_types) / sizeof(char *);
+
+constexpr pattern_automaton_t g_threat_automaton = make_pattern_automaton(g_threat_types, g_threat_types_num);
+
+constexpr const int * g_threat_types_len = g_threat_automaton.lengths;
+
+const static PatternTable g_pattern_table(g_threat_automaton);
 
 /*
  * Vertical,
@@ -137,11 +143,11 @@ public:
    * @param[IN] end end level
    * @return threat list
    * */
-  std::vector<threat_t> & find_all_threats(const State::Position & state_position, std::vector<threat_t> & threats, int begin, int end);
+  std::vector<threat_t> & find_all_threats(const BitBoard & state_board, std::vector<threat_t> & threats, int begin, int end);
 
   /*
    * @brief randomly choose one point (usually used when no threat can be created)
-   * @param[OUT] points possible points on the board
+   * @param[OUT] points empty points within EXPAND_AROUND_RANGE of a stone
    * */
   void find_possible_points(std::vector<point_t> & points);
 private:
@@ -160,21 +166,7 @@ private:
    * @param[Out] threats collection
    * @return gain of threat
    * */
-  int find_threat_at(const State::Position & position, int row, int col, int w, int h, int agent_id, int begin, int end, std::vector<threat_t> & threat_list);
-
-  int find_threat_at(
-          const State::Position & position,
-          const board_t & board,
-          int row, int col, int w, int h, int agent_id, std::vector<threat_t> & threat_list);
-
-  /*
-   * @brief find possible points around specific row and col
-   * @param[OUT] points points collections for output
-   * @param[IN] visited visited positions
-   * @param[IN] row
-   * @param[IN] col
-   **/
-  void find_possible_points_at(std::vector<point_t> & points, std::vector<std::vector<bool>> & visited, int row, int col);
+  int find_threat_at(const BitBoard & board, int row, int col, int agent_id, int begin, int end, std::vector<threat_t> & threat_list);
 };
 
 mcts::Tss::Tss(const mcts::State & state):
@@ -187,32 +179,25 @@ mcts::Tss::~Tss()
 
 }
 
-void Tss::find_possible_points_at(std::vector<point_t> & points, std::vector<std::vector<bool>> & visited, int row, int col)
+void Tss::find_possible_points(std::vector<Tss::point_t> & points)
 {
-    int w = m_state.board_width;
-    int h = m_state.board_height;
-
-    for (int i = row - RANDOM_SEARCH_RANGE; i < row + RANDOM_SEARCH_RANGE; i++) {
-        for (int j = col - RANDOM_SEARCH_RANGE; j < col + RANDOM_SEARCH_RANGE; j++) {
-            if (in_boundary(i, j, w, h)) {
-                if (m_state.position[i][j] == EMPTY && !visited[i][j]) {
-                    visited[i][j] = true;
-                    points.push_back(point_t{i, j});
+    const BitBoard & board = m_state.board;
+    int top, left, bottom, right;
+    board.bounding_box(EXPAND_AROUND_RANGE, top, left, bottom, right);
+    for (int i = top; i <= bottom; i++) {
+        for (int j = left; j <= right; j++) {
+            if (board.at(i, j) != EMPTY) {
+                continue;
+            }
+            /* Off-board cells read as WALL */
+            bool near = false;
+            for (int r = i - EXPAND_AROUND_RANGE; r <= i + EXPAND_AROUND_RANGE && !near; r++) {
+                for (int c = j - EXPAND_AROUND_RANGE; c <= j + EXPAND_AROUND_RANGE && !near; c++) {
+                    near = (board.at(r, c) == BLACK || board.at(r, c) == WHITE);
                 }
             }
-        }
-    }
-}
-
-void Tss::find_possible_points(std::vector<Tss::point_t> & points)
-{
-    std::vector<std::vector<bool>> visited(m_state.board_height,
-            std::vector<bool>(m_state.board_width, false));
-
-    for (int i = 0; i < m_state.board_height; i++) {
-        for (int j = 0; j < m_state.board_width; j++) {
-            if (m_state.position[i][j] != EMPTY) {
-                find_possible_points_at(points, visited, i, j);
+            if (near) {
+                points.push_back(point_t{i, j});
             }
         }
     }
@@ -230,7 +215,7 @@ void Tss::find_all_threats_sequence(std::vector<Tss::point_t> & threat_moves, in
 
 }
 
-std::vector<Tss::threat_t> & Tss::find_all_threats(const State::Position & state_position, std::vector<threat_t> & threats, int begin, int end)
+std::vector<Tss::threat_t> & Tss::find_all_threats(const BitBoard & state_board, std::vector<threat_t> & threats, int begin, int end)
 {
   /* No level 1, for now */
   assert(begin != THREAT_LEVEL_1 && end != THREAT_LEVEL_1);
@@ -238,55 +223,35 @@ std::vector<Tss::threat_t> & Tss::find_all_threats(const State::Position & state
   int w = m_state.board_width;
   int h = m_state.board_height;
 
-  State::Position position = state_position;
+  BitBoard board = state_board;
 
-#if 1
   for (int i = 0; i < h; i++) {
     for (int j = 0; j < w; j++) {
-      if (position[i][j] == mcts::EMPTY) {
-        position[i][j] = m_state.agent_id;
-        find_threat_at(position, i, j, w, h, m_state.agent_id, begin, end, threats);
-        position[i][j] = mcts::EMPTY;
+      if (board.at(i, j) == mcts::EMPTY) {
+        board.set(i, j, m_state.agent_id);
+        find_threat_at(board, i, j, m_state.agent_id, begin, end, threats);
+        board.set(i, j, mcts::EMPTY);
       }
     }
   }
-#else
-  board_t board(h, std::vector<board_node_t>(w));
-  find_connectivities(board, position, m_state.agent_id);
-
-  for (int i = 0; i < h; i++) {
-      for (int j = 0; j < w; j++) {
-        if (position[i][j] == EMPTY) {
-            find_threat_at(position, board, i, j, w, h, m_state.agent_id, threats);
-        }
-      }
-  }
-#endif
   std::sort(threats.begin(), threats.end(), std::greater<threat_t>());
   return threats;
 }
 
-int Tss::find_threat_at(const State::Position & position,
-        int row, int col, int w, int h, int agent_id, int begin, int end, std::vector<threat_t> & threat_list)
+int Tss::find_threat_at(const BitBoard & board,
+        int row, int col, int agent_id, int begin, int end, std::vector<threat_t> & threat_list)
 {
   threat_t threat = threat_t{ point_t{row, col}, 0 };
   int begin_pattern_id = g_threat_levels[begin][BEGIN];
   int end_pattern_id = g_threat_levels[end][END];
+  const uint32_t level_mask = (2U << begin_pattern_id) - (1U << end_pattern_id);
 
   DEBUG_TSS("From %d to %d\n", end_pattern_id, begin_pattern_id);
 
-  for (int k = end_pattern_id; k <= begin_pattern_id; k++) {
-    DEBUG_TSS("Try pattern %d (%s)\n", k, g_threat_types[k]);
-
-    for (int d = 0; d < 4; d++) {
-      int result = match_pattern(position, row, col, w, h, dirs[d][DR], dirs[d][DC],
-        g_threat_types[k], agent_id);
-
-      if (result != MISMATCH) {
-        DEBUG_TSS("Match pattern %d (%s)\n", k, g_threat_types[k]);
-        threat.gain++;
-      }
-    }
+  /* Every pattern of the level range matching in every direction */
+  for (int d = 0; d < 4; d++) {
+    const uint32_t matches = g_pattern_table.matches(board.window(row, col, d), agent_id) & level_mask;
+    threat.gain += __builtin_popcount(matches);
   }
 
   if (threat.gain) {
@@ -296,57 +261,6 @@ int Tss::find_threat_at(const State::Position & position,
   return threat.gain;
 }
 
-int Tss::find_threat_at(
-          const State::Position & position,
-          const board_t & board,
-          int row, int col, int w, int h, int agent_id, std::vector<threat_t> & threat_list)
-{
-    threat_t threat = threat_t { point_t {row, col}, 0 };
-    for (int k = 0; k < NUM_DIR; k++) {
-        int connectivity = 1;
-        int dr = dirs[k][DR];
-        int dc = dirs[k][DC];
-        int pr = row + dr;
-        int pc = col + dc;
-        int nr = row - dr;
-        int nc = col - dc;
-
-        if (in_boundary(pr, pc, w, h)) {
-            if (position[pr][pc] == EMPTY) {
-                pr += dr;
-                pc += dc;
-            }
-
-            if (in_boundary(pr, pc, w, h) && position[pr][pc] == agent_id) {
-                connectivity += board[pr][pc].connectivity[k];
-                DEBUG_TSS("Connect %d, %d in k %d dir\n", pr, pc, k);
-            }
-        }
-
-        if (in_boundary(nr, nc, w, h)) {
-            if (position[nr][nc] == EMPTY) {
-                nr += dr;
-                nc += dc;
-            }
-
-            if (in_boundary(nr, nc, w, h) && position[nr][nc] == agent_id) {
-                connectivity += board[nr][nc].connectivity[k];
-                DEBUG_TSS("Connect %d, %d in k %d dir\n", nr, nc, k);
-            }
-        }
-
-       if (connectivity >= GAIN_CONNECTIVITY_THRESHOLD) {
-            threat.gain++;
-        }
-    }
-
-    if (threat.gain) {
-        threat_list.push_back(threat);
-    }
-
-    return threat.gain;
-}
-
 }
 
 #endif
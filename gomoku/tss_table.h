@@ -0,0 +1,136 @@
+#ifndef _TSS_TABLE_H_
+#define _TSS_TABLE_H_
+
+#include <atomic>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <utility>
+
+/* log2 of the buckets of the threat search table, 32 bytes each */
+#ifndef TSS_TABLE_BITS
+#define TSS_TABLE_BITS 15
+#endif
+
+namespace mcts
+{
+
+/*
+ * Results of the threat space search below a gain square, shared by all
+ * searches of the process.
+ * A search below a gain square only depends on the board (stones and
+ * cost squares), the board size, the attacker, the gain square it starts
+ * from, the level range and the remaining depth; the first five make the
+ * key, the depth is kept in the entry. An entry searched with depth d
+ * answers every depth when it found a win, and depths up to d otherwise.
+ * Each bucket holds an entry replaced only by deeper (or equal) searches
+ * and one replaced always. Entries are two words, the key stored xor the
+ * data, so a torn write by another thread reads as a miss without locks.
+ */
+class TssTable
+{
+public:
+  TssTable()
+  {
+    clear();
+  }
+
+  TssTable(const TssTable &) = delete;
+  TssTable & operator=(const TssTable &) = delete;
+
+  /* Entries keep flat cell indices below MAX_CELLS; larger boards go without the table */
+  static const int GAIN_BITS = 24;
+  static const int MAX_CELLS = 1 << GAIN_BITS;
+
+  static uint64_t key(uint64_t board_hash, int height, int width, int agent_id, int begin, int end, int origin)
+  {
+    /* Mixed apart from zobrist_key(), whose keys make up board_hash */
+    uint64_t z = (uint64_t)origin;
+    z = (z << 13) | (uint64_t)height;
+    z = (z << 13) | (uint64_t)width;
+    z = (z << 1) | (uint64_t)agent_id;
+    z = (z << 3) | (uint64_t)begin;
+    z = (z << 3) | (uint64_t)end;
+    z = (z ^ (z >> 31)) * 0x7fb5d329728ea185ULL;
+    z = (z ^ (z >> 27)) * 0x81dadef4bc2dd44dULL;
+    return board_hash ^ z ^ (z >> 33);
+  }
+
+  /*
+   * @brief result of a search with depth levels left at key
+   *        res gets (winning, depth of the shortest win from the node,
+   *        INT_MAX for none), best_gain the cell starting it, or -1, and
+   *        best_pattern the threat pattern matched there
+   * @return whether the table knows the result
+   * */
+  bool probe(uint64_t key, int depth, std::pair<bool, int> & res, int & best_gain, int & best_pattern) const
+  {
+    const slot_t * bucket = m_slots + 2 * (key & BUCKET_MASK);
+    for (int k = 0; k < 2; k++) {
+      const uint64_t data = bucket[k].data.load(std::memory_order_relaxed);
+      const uint64_t check = bucket[k].check.load(std::memory_order_relaxed);
+      if ((check ^ data) != key || data == 0) {
+        continue;
+      }
+      const int entry_depth = (data >> DEPTH_SHIFT) & 0xff;
+      const bool winning = (data >> WIN_SHIFT) & 1;
+      const int min_depth = (data >> MIN_DEPTH_SHIFT) & 0xff;
+      if (winning || depth <= entry_depth) {
+        res.first = winning && min_depth < depth;
+        res.second = (res.first) ? min_depth : INT_MAX;
+        best_gain = (res.first) ? (int)(data & GAIN_MASK) : -1;
+        best_pattern = (int)((data >> PATTERN_SHIFT) & 0xff);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /*
+   * @brief keep res of a search with depth levels left, as probe() gives it
+   * */
+  void store(uint64_t key, int depth, const std::pair<bool, int> & res, int best_gain, int best_pattern)
+  {
+    assert(depth > 0 && depth < 0xff);
+    assert(best_gain < MAX_CELLS && best_pattern >= 0 && best_pattern <= 0xff);
+    const uint64_t data = (uint64_t)(best_gain & GAIN_MASK) |
+                          ((uint64_t)best_pattern << PATTERN_SHIFT) |
+                          ((uint64_t)depth << DEPTH_SHIFT) |
+                          ((uint64_t)((res.first) ? res.second : 0xff) << MIN_DEPTH_SHIFT) |
+                          ((uint64_t)res.first << WIN_SHIFT);
+    slot_t * bucket = m_slots + 2 * (key & BUCKET_MASK);
+    const uint64_t deep = bucket[0].data.load(std::memory_order_relaxed);
+    slot_t & slot = ((int)((deep >> DEPTH_SHIFT) & 0xff) <= depth) ? bucket[0] : bucket[1];
+    slot.data.store(data, std::memory_order_relaxed);
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+  }
+
+  void clear()
+  {
+    for (slot_t & slot : m_slots) {
+      slot.data.store(0, std::memory_order_relaxed);
+      slot.check.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  static const uint64_t BUCKET_MASK = (1ULL << TSS_TABLE_BITS) - 1;
+  /* Data: best gain cell in the low GAIN_BITS bits, then its pattern, depth, min depth, win */
+  static const uint64_t GAIN_MASK = (1ULL << GAIN_BITS) - 1;
+  static const int PATTERN_SHIFT = GAIN_BITS;
+  static const int DEPTH_SHIFT = 32;
+  static const int MIN_DEPTH_SHIFT = 40;
+  static const int WIN_SHIFT = 48;
+
+  struct slot_t
+  {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data;
+  };
+
+  slot_t m_slots[2 << TSS_TABLE_BITS];
+};
+
+}
+
+#endif
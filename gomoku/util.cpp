@@ -3,7 +3,7 @@
 namespace mcts
 {
 
-int util_check_chain(const Position & position, int w, int h, int row, int col, int dr, int dc, int agent_id)
+int util_check_chain(const BitBoard & board, int w, int h, int row, int col, int dr, int dc, int agent_id)
 {
   int i = row;
   int j = col;
@@ -12,7 +12,7 @@ int util_check_chain(const Position & position, int w, int h, int row, int col,
     if (i < 0 || i >= h || j < 0 || j >= w) {
       break;
     }
-    if (position[i][j] != agent_id) {
+    if (board.at(i, j) != agent_id) {
       break;
     }
     i += dr;
@@ -23,43 +23,68 @@ int util_check_chain(const Position & position, int w, int h, int row, int col,
 
 /*
  * @brief check winning status
+ *        only the bounding box of the stones is scanned
  * @return BLACK black win
  *         WHITE white win
  *         EMPTY tie
  *         NOT_END not end
  * */
-int util_check_win(const Position & position, int w, int h)
+int util_check_win(const BitBoard & board)
 {
-  const static int dirs[][2] = {
-    {1, 0},
-    {0, 1},
-    {1, 1},
-    {-1, 1}
-  };
+  int top, left, bottom, right;
+  board.bounding_box(0, top, left, bottom, right);
 
-  const static int dir_num = 4;
-
-  bool is_tie = true;
-
-  for (int k = 0; k < dir_num; k++) {
-    int dr = dirs[k][0];
-    int dc = dirs[k][1];
-    for (int i = 0; i < h; i++) {
-      for (int j = 0; j < w; j++) {
-        int chess = position[i][j];
-        if (position[i][j] != EMPTY) {
-          int len = util_check_chain(position, h, w, i, j, dr, dc, chess);
-          if (len == NUMTOWIN) {
-            return chess;
-          }
-        } else {
-          is_tie = false;
+  for (int i = top; i <= bottom; i++) {
+    for (int j = left; j <= right; j++) {
+      const int index = BitBoard::index(i, j);
+      const int chess = board.at(index);
+      if (chess == EMPTY) {
+        continue;
+      }
+      for (int dir = 0; dir < NUM_DIR; dir++) {
+        /* Cells off the board read as WALL and end the chain */
+        const int * steps = BitBoard::geometry::rays.steps[dir];
+        int len = 1;
+        while (len < NUMTOWIN && board.at(index + steps[len]) == chess) {
+          len++;
+        }
+        if (len == NUMTOWIN) {
+          return chess;
         }
       }
     }
   }
 
-  return (is_tie) ? EMPTY : NOT_END;
+  return (board.is_full()) ? EMPTY : NOT_END;
+}
+
+/*
+ * @brief check winning status after a stone was placed at (row, col)
+ *        only the four lines through the last stone can hold a new five;
+ *        the walk stops on the WALL cells, so it needs no bounds check
+ * @return same as util_check_win
+ * */
+int util_check_win_at(const BitBoard & board, int row, int col)
+{
+  const int index = BitBoard::index(row, col);
+  const int chess = board.at(index);
+  assert(chess == BLACK || chess == WHITE);
+
+  for (int dir = 0; dir < NUM_DIR; dir++) {
+    const int offset = BitBoard::geometry::offset(dir);
+    int len = 1;
+    for (int k = index + offset; len < NUMTOWIN && board.at(k) == chess; k += offset) {
+      len++;
+    }
+    for (int k = index - offset; len < NUMTOWIN && board.at(k) == chess; k -= offset) {
+      len++;
+    }
+    if (len >= NUMTOWIN) {
+      return chess;
+    }
+  }
+
+  return (board.is_full()) ? EMPTY : NOT_END;
 }
 
 
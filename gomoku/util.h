@@ -4,6 +4,7 @@
 #include <iostream>
 #include <vector>
 
+#include "bitboard.h"
 #include "board.h"
 #include "constants.h"
 
@@ -17,8 +18,9 @@ namespace mcts
 typedef std::vector<std::vector<char> > Position;
 struct point_t;
 
-int util_check_chain(const Position & position, int w, int h, int row, int col, int dr, int dc, int agent_id);
-int util_check_win(const Position & position, int w, int h);
+int util_check_chain(const BitBoard & board, int w, int h, int row, int col, int dr, int dc, int agent_id);
+int util_check_win(const BitBoard & board);
+int util_check_win_at(const BitBoard & board, int row, int col);
 void print_position(std::ostream& strm, const Position& position);
 void load_position_from(std::istream & in, Position & position, int w, int h);
 void find_position_diff(const Position& before, const Position& after,